@@ -0,0 +1,290 @@
+#include "../src/VFTHook.h"
+
+#include <cstdio>
+#include <array>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <utility>
+
+// A standalone console benchmark for catching regressions in the scanner and the hook templates.
+// Build it as an x64 console application with RTTI enabled and optimizations on, e.g. cl /O2 /EHsc /std:c++17 benchmark.cpp
+// The scan benchmarks scan this executable, which holds BENCHMARK_CLASS_COUNT generated polymorphic classes.
+
+#ifndef BENCHMARK_CLASS_COUNT
+#define BENCHMARK_CLASS_COUNT 4096
+#endif
+
+#ifndef BENCHMARK_ITERATIONS
+#define BENCHMARK_ITERATIONS 2000000
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+/// <summary>
+/// The base of every generated class, the generated classes only exist to give the scanner something to find.
+/// </summary>
+struct GeneratedBase {
+    virtual ~GeneratedBase() = default;
+    virtual size_t value() const = 0;
+};
+
+template <size_t N> struct Generated : GeneratedBase {
+    size_t value() const override { return N; }
+};
+
+template <size_t N> GeneratedBase* createGenerated() { return new Generated<N>(); }
+
+/// <summary>
+/// Constructing one instance of every generated class makes sure the compiler emits all of their virtual function tables and RTTI.
+/// </summary>
+template <size_t... I> size_t touchGenerated(std::index_sequence<I...>)
+{
+    static GeneratedBase* (*const factories[])() = { &createGenerated<I>... };
+
+    size_t sum = 0;
+    for (auto factory : factories) {
+        std::unique_ptr<GeneratedBase> instance(factory());
+        sum += instance->value();
+    }
+    return sum;
+}
+
+/// <summary>
+/// Runs a function a number of times and returns the average duration of a run in milliseconds.
+/// </summary>
+template <typename F> double timeMilliseconds(int runs, F&& function)
+{
+    auto start = Clock::now();
+    for (int i = 0; i < runs; ++i) function();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / runs;
+}
+
+void benchmarkScan()
+{
+    const size_t touched = touchGenerated(std::make_index_sequence<BENCHMARK_CLASS_COUNT>{});
+    std::printf("scan: %d generated classes (checksum %zu)\n", BENCHMARK_CLASS_COUNT, touched);
+
+    const double parseTime = timeMilliseconds(100, []() {
+        PEParser parser;
+        parser.parse();
+    });
+    std::printf("  PEParser::parse                %10.3f ms\n", parseTime);
+
+    // no cache file, every scan goes through the .rdata section(s)
+    size_t classCount = 0;
+    const double serialTime = timeMilliseconds(5, [&classCount]() {
+        RTTIScanner scanner;
+        scanner.scan();
+        classCount = RTTIScanner::getClassCount();
+    });
+    std::printf("  RTTIScanner::scan (serial)     %10.3f ms, %zu classes\n", serialTime, classCount);
+
+    const double parallelTime = timeMilliseconds(5, []() {
+        RTTIScanner scanner;
+        scanner.scan(nullptr, 0);
+    });
+    std::printf("  RTTIScanner::scan (parallel)   %10.3f ms\n", parallelTime);
+
+    // a cold cache scans and writes the cache file, a warm cache rebuilds the class map from it
+    const std::string cachePath = "benchmark.rtticache";
+    const double coldTime = timeMilliseconds(5, [&cachePath]() {
+        std::remove(cachePath.c_str());
+        RTTIScanner scanner;
+        scanner.enableCache(cachePath);
+        scanner.scan();
+    });
+    std::printf("  RTTIScanner::scan (cold cache) %10.3f ms\n", coldTime);
+
+    const double warmTime = timeMilliseconds(5, [&cachePath]() {
+        RTTIScanner scanner;
+        scanner.enableCache(cachePath);
+        scanner.scan();
+    });
+    std::printf("  RTTIScanner::scan (warm cache) %10.3f ms\n", warmTime);
+    std::remove(cachePath.c_str());
+
+    // the exports stream the class map of a scan to disk
+    RTTIScanner scanner;
+    scanner.scan();
+    const std::string binaryPath = "benchmark.rttidump";
+    const double binaryTime = timeMilliseconds(5, [&binaryPath]() { RTTIExporter::exportBinary(binaryPath); });
+    std::printf("  RTTIExporter::exportBinary     %10.3f ms\n", binaryTime);
+
+    const std::string jsonPath = "benchmark.json";
+    const double jsonTime = timeMilliseconds(5, [&jsonPath]() { RTTIExporter::exportJSON(jsonPath); });
+    std::printf("  RTTIExporter::exportJSON       %10.3f ms\n", jsonTime);
+    std::remove(binaryPath.c_str());
+    std::remove(jsonPath.c_str());
+
+    // the first query builds the sorted name index, later ones only search it
+    size_t matchCount = 0;
+    const double indexTime = timeMilliseconds(1, [&matchCount]() { matchCount = RTTIScanner::findClasses("Generated<*1>").size(); });
+    std::printf("  RTTIScanner::findClasses (cold) %9.3f ms, %zu classes\n", indexTime, matchCount);
+
+    const double queryTime = timeMilliseconds(100, []() { RTTIScanner::findClasses("Generated<*1>"); });
+    std::printf("  RTTIScanner::findClasses        %9.3f ms\n", queryTime);
+}
+
+/// <summary>
+/// The hooked class. The virtual function is the first entry of its virtual function table.
+/// </summary>
+struct BenchTarget {
+    virtual int call(int value);
+};
+
+__declspec(noinline) int BenchTarget::call(int value) { return value + 1; }
+
+// A hook function matching every hook type except ThunkHook. The first argument is a context for OverrideHook and ContextHook, it is not used.
+int hookFunction(void*, int value) { return value + 1; }
+
+// ThunkHook functions call the original function through their own trampolines, one function per chain depth.
+using ThunkFunction = int (*)(void*, int);
+
+constexpr size_t maxDepth = 16;
+static ThunkFunction thunkOriginals[maxDepth]{};
+
+template <size_t D> int thunkFunction(void* instance, int value) { return thunkOriginals[D](instance, value); }
+
+template <size_t... I> constexpr std::array<ThunkFunction, sizeof...(I)> makeThunkFunctions(std::index_sequence<I...>)
+{
+    return { &thunkFunction<I>... };
+}
+
+static constexpr std::array<ThunkFunction, maxDepth> thunkFunctions = makeThunkFunctions(std::make_index_sequence<maxDepth>{});
+
+// keeps the results of the calls alive
+static std::atomic<int> sink = 0;
+
+/// <summary>
+/// Calls the virtual function from a number of threads at once.
+/// </summary>
+/// <returns>the average time of a call in nanoseconds, over all threads</returns>
+double measureCalls(BenchTarget* target, unsigned int threadCount)
+{
+    std::atomic<unsigned int> ready = 0;
+    std::atomic<bool> start = false;
+    std::vector<double> results(threadCount);
+
+    auto worker = [&](unsigned int index) {
+        BenchTarget* volatile instance = target; // keeps the call virtual
+        ++ready;
+        while (!start) std::this_thread::yield();
+
+        int value = 0;
+        auto begin = Clock::now();
+        for (int i = 0; i < BENCHMARK_ITERATIONS; ++i) value = instance->call(value) & 0xFF;
+        results[index] = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / BENCHMARK_ITERATIONS;
+        sink += value;
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < threadCount; ++i) threads.emplace_back(worker, i);
+    while (ready != threadCount) std::this_thread::yield();
+    start = true;
+    for (auto& thread : threads) thread.join();
+
+    double total = 0.0;
+    for (double result : results) total += result;
+    return total / threadCount;
+}
+
+std::vector<unsigned int> getThreadCounts()
+{
+    // the striped hooks' pools hold UNIHOOK_THREAD_ACCESS_LIMIT (32 by default) entries, more threads would only measure waiting
+    const unsigned int limit = (std::min)(std::thread::hardware_concurrency(), 32u);
+
+    std::vector<unsigned int> counts;
+    for (unsigned int count = 1; count < limit; count *= 2) counts.push_back(count);
+    counts.push_back((std::max)(limit, 1u));
+    return counts;
+}
+
+template <typename Hook> void benchmarkHook(const char* name, BenchTarget* target, const std::vector<unsigned int>& threadCounts, bool compile = false)
+{
+    void** vft = *reinterpret_cast<void***>(target);
+
+    for (size_t depth : { 1, 4, 16 }) {
+        std::vector<std::unique_ptr<VFTHookTemplate<Hook>>> hooks;
+        for (size_t i = 0; i < depth; ++i) {
+            if constexpr (std::is_same_v<Hook, ThunkHook>) {
+                hooks.emplace_back(new VFTHookTemplate<Hook>(vft, 0, thunkFunctions[i], &thunkOriginals[i]));
+            }
+            else {
+                hooks.emplace_back(new VFTHookTemplate<Hook>(vft, 0, hookFunction));
+            }
+        }
+        if (compile) HookChainCompiler::compile(vft, 0);
+
+        std::printf("  %-32s depth %2zu:", name, depth);
+        for (unsigned int threadCount : threadCounts) std::printf(" %8.2f", measureCalls(target, threadCount));
+        std::printf("\n");
+
+        // unhook from the top of the chain down, then wait for the instances to be freed
+        while (!hooks.empty()) hooks.pop_back();
+        // the calling threads have joined, no thread is left inside of a ThunkHook function
+        if constexpr (std::is_same_v<Hook, ThunkHook>) HookReclaimer::releaseThunks();
+        if (!HookReclaimer::drain(std::chrono::milliseconds(1000))) std::printf("  %-32s depth %2zu: unhooked instances were not freed\n", name, depth);
+    }
+}
+
+void benchmarkHooks()
+{
+    BenchTarget* target = new BenchTarget();
+    const std::vector<unsigned int> threadCounts = getThreadCounts();
+
+    std::printf("hooks: ns/call with");
+    for (unsigned int threadCount : threadCounts) std::printf(" %2u thread(s)", threadCount);
+    std::printf("\n");
+
+    std::printf("  %-32s         :", "unhooked");
+    for (unsigned int threadCount : threadCounts) std::printf(" %8.2f", measureCalls(target, threadCount));
+    std::printf("\n");
+
+    benchmarkHook<EntryHook>("EntryHook", target, threadCounts);
+    benchmarkHook<ExitHook>("ExitHook", target, threadCounts);
+    benchmarkHook<ReturnHook>("ReturnHook", target, threadCounts);
+    benchmarkHook<OverrideHook>("OverrideHook", target, threadCounts);
+    benchmarkHook<ContextHook>("ContextHook", target, threadCounts);
+    benchmarkHook<EntryHookV>("EntryHookV", target, threadCounts);
+    benchmarkHook<EntryHook>("EntryHook (compiled chain)", target, threadCounts, true);
+    benchmarkHook<EntryHookV>("EntryHookV (compiled chain)", target, threadCounts, true);
+    benchmarkHook<ExitHookV>("ExitHookV", target, threadCounts);
+    benchmarkHook<ReturnHookV>("ReturnHookV", target, threadCounts);
+    benchmarkHook<OverrideHookV>("OverrideHookV", target, threadCounts);
+    benchmarkHook<ContextHookV>("ContextHookV", target, threadCounts);
+    benchmarkHook<EntryHookTLS>("EntryHookTLS", target, threadCounts);
+    benchmarkHook<ExitHookTLS>("ExitHookTLS", target, threadCounts);
+    benchmarkHook<ReturnHookTLS>("ReturnHookTLS", target, threadCounts);
+    benchmarkHook<OverrideHookTLS>("OverrideHookTLS", target, threadCounts);
+    benchmarkHook<ContextHookTLS>("ContextHookTLS", target, threadCounts);
+    benchmarkHook<EntryHookVTLS>("EntryHookVTLS", target, threadCounts);
+    benchmarkHook<ExitHookVTLS>("ExitHookVTLS", target, threadCounts);
+    benchmarkHook<ReturnHookVTLS>("ReturnHookVTLS", target, threadCounts);
+    benchmarkHook<OverrideHookVTLS>("OverrideHookVTLS", target, threadCounts);
+    benchmarkHook<ContextHookVTLS>("ContextHookVTLS", target, threadCounts);
+    benchmarkHook<EntryHookStriped>("EntryHookStriped", target, threadCounts);
+    benchmarkHook<ExitHookStriped>("ExitHookStriped", target, threadCounts);
+    benchmarkHook<ReturnHookStriped>("ReturnHookStriped", target, threadCounts);
+    benchmarkHook<OverrideHookStriped>("OverrideHookStriped", target, threadCounts);
+    benchmarkHook<ContextHookStriped>("ContextHookStriped", target, threadCounts);
+    benchmarkHook<EntryHookVStriped>("EntryHookVStriped", target, threadCounts);
+    benchmarkHook<ExitHookVStriped>("ExitHookVStriped", target, threadCounts);
+    benchmarkHook<ReturnHookVStriped>("ReturnHookVStriped", target, threadCounts);
+    benchmarkHook<OverrideHookVStriped>("OverrideHookVStriped", target, threadCounts);
+    benchmarkHook<ContextHookVStriped>("ContextHookVStriped", target, threadCounts);
+    benchmarkHook<ThunkHook>("ThunkHook", target, threadCounts);
+    benchmarkHook<InstrumentedHook<EntryHook>>("InstrumentedHook<EntryHook>", target, threadCounts);
+
+    delete target;
+}
+
+int main()
+{
+    benchmarkScan();
+    benchmarkHooks();
+    return 0;
+}
@@ -4,22 +4,37 @@
 #include <array>
 #include <memory>
 #include <cstddef>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <atomic>
+#include <type_traits>
+#include <thread>
+#include <intrin.h>
 #include <processthreadsapi.h>
+#include <memoryapi.h>
 
 #ifdef UNIHOOK_THREAD_ACCESS_LIMIT
 #undef UNIHOOK_THREAD_ACCESS_LIMIT
 #endif
 
-// The maximum amount of threads that may access a single hook simultaneosly.
-// The default value of 32 is already overkill, but it does not hurt performance either.
-// It regulates how many context entries are allocated for each hook instance.
+// The maximum size of the first block of context entries of a hook instance, and the exact size of the pools of the striped hook variants.
+// The default pool starts out with one entry per hardware thread up to this limit and grows past it on demand, see HookContextPool.
+// The striped pools are fixed, threads past the limit wait for an entry to be returned.
 #define UNIHOOK_THREAD_ACCESS_LIMIT 32
 
-// A struct for holding the combined context of (most of) the registers.
-// It is allocated automatically by hook templates.
-struct alignas(16) HookContext {
+#ifdef UNIHOOK_THREAD_CONTEXT_DEPTH
+#undef UNIHOOK_THREAD_CONTEXT_DEPTH
+#endif
+
+// The amount of nested hooked calls a single thread may be inside of before the TLS hook variants fall back to pooled contexts.
+// It regulates how many context entries are allocated for each thread entering such a hook.
+#define UNIHOOK_THREAD_CONTEXT_DEPTH 32
+
+// A struct for holding the context of the integer registers.
+// It is allocated automatically by the integer-only hook templates, and makes up the beginning of HookContext.
+struct alignas(16) HookIntegerContext {
 	using reg64 = uint64_t;
-	using imm256 = float[8];
 	reg64 rax;
 	reg64 rbx;
 	reg64 rcx;
@@ -36,6 +51,12 @@ struct alignas(16) HookContext {
 	reg64 r13;
 	reg64 r14;
 	reg64 r15;
+};
+
+// A struct for holding the combined context of (most of) the registers.
+// It is allocated automatically by the V hook templates.
+struct alignas(16) HookContext : HookIntegerContext {
+	using imm256 = float[8];
 	imm256 imm0;
 	imm256 imm1;
 	imm256 imm2;
@@ -54,82 +75,821 @@ struct alignas(16) HookContext {
 	imm256 imm15;
 };
 
+static_assert(sizeof(HookIntegerContext) == 0x80 && sizeof(HookContext) == 0x280, "the hook assembly encodes the context layout");
+
+// The default context pool of a hook: blocks of context entries linked into a list, which only ever grows.
+// The pool pointer of a hook points to a block header, the entries of the block directly follow it:
+// pool[-3] grows the pool, pool[-2] is the next block, pool[-1] is the entry count and pool[0] is the shared slow path routine.
+// The inlined stubs only try the first entry of the first block. If it is taken they call the routine, which probes every entry
+// of every block and, once all of them are taken, links in another block of twice the size, lock free. The first thread to link a block wins,
+// the others free theirs and use it. Blocks stay linked until the hook instance is destroyed.
+class HookContextPool {
+public:
+	// The header of a block, the pool pointer points to its last field.
+	struct BlockHeader {
+		void** (__cdecl* grow)(void** pool);
+		std::atomic<void**> next;
+		uintptr_t count;
+		void* routine;
+	};
+
+	static_assert(sizeof(BlockHeader) == 4 * sizeof(void*) && offsetof(BlockHeader, routine) == 3 * sizeof(void*), "the pool routine encodes the block header layout");
+
+	/// <summary>
+	/// Static. Gets the slow path routine shared by every default pool, creating it on first use.
+	/// </summary>
+	/// <returns>a pointer to the executable routine, otherwise nullptr if it could not be created</returns>
+	static void* getRoutine()
+	{
+		std::call_once(HookContextPool::routineFlag, HookContextPool::createRoutine);
+		return HookContextPool::routine;
+	}
+
+	/// <summary>
+	/// Static. Gets the amount of entries of the first block of a pool: one per hardware thread, at least 4 and at most UNIHOOK_THREAD_ACCESS_LIMIT.
+	/// </summary>
+	static size_t getInitialSize()
+	{
+		static const size_t size = (std::min)((std::max)(static_cast<size_t>(std::thread::hardware_concurrency()), static_cast<size_t>(4)), static_cast<size_t>(UNIHOOK_THREAD_ACCESS_LIMIT));
+		return size;
+	}
+
+	static BlockHeader* getHeader(void** pool) noexcept { return reinterpret_cast<BlockHeader*>(pool - 3); }
+
+	/// <summary>
+	/// Static. Fills in the header and the entries of a block.
+	/// </summary>
+	/// <param name="pool">: the pool pointer of the block, followed by count entries</param>
+	/// <param name="contexts">: count contexts for the entries</param>
+	template <typename Context> static void initBlock(void** pool, Context* contexts, size_t count)
+	{
+		BlockHeader* header = HookContextPool::getHeader(pool);
+		header->grow = &HookContextPool::grow<Context>;
+		header->next.store(nullptr, std::memory_order_relaxed);
+		header->count = count;
+		header->routine = HookContextPool::getRoutine();
+
+		for (size_t i = 0; i < count; ++i) pool[i + 1] = &contexts[i];
+	}
+
+	/// <summary>
+	/// Static. Tells whether every context of every block of a pool is back in it.
+	/// </summary>
+	static bool isFull(void** pool) noexcept
+	{
+		for (; pool; pool = HookContextPool::getHeader(pool)->next.load(std::memory_order_acquire)) {
+			void* const volatile* entries = pool + 1;
+			for (size_t i = 0; i < HookContextPool::getHeader(pool)->count; ++i) {
+				if (!entries[i]) return false;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Static. Frees the blocks linked to the first block of a pool, the first block belongs to the hook instance.
+	/// </summary>
+	static void freeBlocks(void** pool) noexcept
+	{
+		void** block = HookContextPool::getHeader(pool)->next.load(std::memory_order_acquire);
+		while (block) {
+			void** next = HookContextPool::getHeader(block)->next.load(std::memory_order_relaxed);
+			::operator delete(HookContextPool::getHeader(block), std::align_val_t{ HookContextPool::blockAlignment });
+			block = next;
+		}
+	}
+
+private:
+	static constexpr size_t blockAlignment = 64;
+
+	// Called from the routine once every entry of every block is taken, must not throw.
+	// Returns the next block of the last block, nullptr if a block could not be allocated.
+	template <typename Context> static void** __cdecl grow(void** pool) noexcept
+	{
+		BlockHeader* header = HookContextPool::getHeader(pool);
+		if (void** next = header->next.load(std::memory_order_acquire)) return next;
+
+		// the entries are padded to a cache line, so the contexts are as aligned as the block
+		const size_t count = header->count * 2;
+		const size_t entriesSize = (sizeof(BlockHeader) + count * sizeof(void*) + blockAlignment - 1) & ~(blockAlignment - 1);
+		void* allocation = ::operator new(entriesSize + count * sizeof(Context), std::align_val_t{ blockAlignment }, std::nothrow);
+		if (!allocation) return nullptr;
+
+		Context* contexts = reinterpret_cast<Context*>(reinterpret_cast<uint8_t*>(allocation) + entriesSize);
+		memset(contexts, 0, count * sizeof(Context));
+		void** block = reinterpret_cast<void**>(allocation) + 3;
+		HookContextPool::initBlock(block, contexts, count);
+
+		void** expected = nullptr;
+		if (header->next.compare_exchange_strong(expected, block, std::memory_order_acq_rel)) return block;
+
+		::operator delete(allocation, std::align_val_t{ blockAlignment });
+		return expected;
+	}
+
+	static void createRoutine()
+	{
+		uint8_t* code = reinterpret_cast<uint8_t*>(VirtualAlloc(nullptr, 0x1000, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+		if (!code) return;
+
+		memcpy(code, HookContextPool::routineCode, sizeof(HookContextPool::routineCode));
+
+		DWORD oldProtect;
+		VirtualProtect(code, 0x1000, PAGE_EXECUTE_READ, &oldProtect);
+		FlushInstructionCache(GetCurrentProcess(), code, 0x1000);
+
+		HookContextPool::routine = code;
+	}
+
+	// The slow path of HookBorrowContext and HookReturnContext, called with r10 holding the first block's pool pointer.
+	// The stubs tell it apart through the zero flag, set when borrowing and clear when returning the context in r11.
+	// Register contract, for both directions:
+	// - rax receives the borrowed context, or is clobbered when returning; every other general purpose register is preserved;
+	// - the arithmetic flags are clobbered, the direction flag must be clear as for any call;
+	// - xmm0-xmm5 are preserved, xmm6-xmm15 too as the allocator follows the calling convention, upper halves of ymm registers are not;
+	// - it runs on the caller's stack: 16 bytes and the return address, and growing adds about 0xC0 bytes plus the allocator's frames.
+	// Borrowing grows the pool when every block is empty, and starts over from the first block if allocating fails.
+	// Returning starts over from the first block until a slot is free, the pool always has one for every context lent out.
+	static constexpr uint8_t routineCode[200] = {
+		0x75, 0x29,                                     // jnz    give_back
+		0x41, 0x52,                                     // push   r10
+		0x51,                                           // push   rcx
+		0x49, 0x8B, 0x4A, 0xF8,                         // mov    rcx,[block_count] <- borrow_block
+		0x31, 0xC0,                                     // xor    eax,eax <- borrow_loop
+		0x49, 0x87, 0x04, 0xCA,                         // xchg   [r10+rcx*8],rax
+		0x48, 0x85, 0xC0,                               // test   rax,rax
+		0x75, 0x13,                                     // jnz    borrow_done
+		0x48, 0xFF, 0xC9,                               // dec    rcx
+		0x75, 0xF0,                                     // jnz    borrow_loop
+		0x49, 0x8B, 0x42, 0xF0,                         // mov    rax,[block_next]
+		0x48, 0x85, 0xC0,                               // test   rax,rax
+		0x74, 0x33,                                     // je     grow
+		0x49, 0x89, 0xC2,                               // mov    r10,rax <- link
+		0xEB, 0xDE,                                     // jmp    borrow_block
+		0x59,                                           // pop    rcx <- borrow_done
+		0x41, 0x5A,                                     // pop    r10
+		0xC3,                                           // ret
+		0x41, 0x52,                                     // push   r10 <- give_back
+		0x51,                                           // push   rcx
+		0x49, 0x8B, 0x4A, 0xF8,                         // mov    rcx,[block_count] <- return_block
+		0x31, 0xC0,                                     // xor    eax,eax <- return_loop
+		0xF0, 0x4D, 0x0F, 0xB1, 0x1C, 0xCA,             // lock cmpxchg [r10+rcx*8],r11
+		0x74, 0x15,                                     // je     return_done
+		0x48, 0xFF, 0xC9,                               // dec    rcx
+		0x75, 0xF1,                                     // jnz    return_loop
+		0x4D, 0x8B, 0x52, 0xF0,                         // mov    r10,[block_next]
+		0x4D, 0x85, 0xD2,                               // test   r10,r10
+		0x75, 0xE4,                                     // jnz    return_block
+		0x4C, 0x8B, 0x54, 0x24, 0x08,                   // mov    r10,[first_block]
+		0xEB, 0xDD,                                     // jmp    return_block
+		0x59,                                           // pop    rcx <- return_done
+		0x41, 0x5A,                                     // pop    r10
+		0xC3,                                           // ret
+		0x52,                                           // push   rdx <- grow
+		0x41, 0x50,                                     // push   r8
+		0x41, 0x51,                                     // push   r9
+		0x41, 0x53,                                     // push   r11
+		0x55,                                           // push   rbp
+		0x48, 0x89, 0xE5,                               // mov    rbp,rsp
+		0x48, 0x83, 0xE4, 0xF0,                         // and    rsp,-16
+		0x48, 0x81, 0xEC, 0x80, 0x00, 0x00, 0x00,       // sub    rsp,0x80
+		0x0F, 0x29, 0x44, 0x24, 0x20,                   // movaps [rsp+0x20],xmm0
+		0x0F, 0x29, 0x4C, 0x24, 0x30,                   // movaps [rsp+0x30],xmm1
+		0x0F, 0x29, 0x54, 0x24, 0x40,                   // movaps [rsp+0x40],xmm2
+		0x0F, 0x29, 0x5C, 0x24, 0x50,                   // movaps [rsp+0x50],xmm3
+		0x0F, 0x29, 0x64, 0x24, 0x60,                   // movaps [rsp+0x60],xmm4
+		0x0F, 0x29, 0x6C, 0x24, 0x70,                   // movaps [rsp+0x70],xmm5
+		0x4C, 0x89, 0xD1,                               // mov    rcx,r10
+		0x41, 0xFF, 0x52, 0xE8,                         // call   [block_grow]
+		0x0F, 0x28, 0x44, 0x24, 0x20,                   // movaps xmm0,[rsp+0x20]
+		0x0F, 0x28, 0x4C, 0x24, 0x30,                   // movaps xmm1,[rsp+0x30]
+		0x0F, 0x28, 0x54, 0x24, 0x40,                   // movaps xmm2,[rsp+0x40]
+		0x0F, 0x28, 0x5C, 0x24, 0x50,                   // movaps xmm3,[rsp+0x50]
+		0x0F, 0x28, 0x64, 0x24, 0x60,                   // movaps xmm4,[rsp+0x60]
+		0x0F, 0x28, 0x6C, 0x24, 0x70,                   // movaps xmm5,[rsp+0x70]
+		0x48, 0x89, 0xEC,                               // mov    rsp,rbp
+		0x5D,                                           // pop    rbp
+		0x41, 0x5B,                                     // pop    r11
+		0x41, 0x59,                                     // pop    r9
+		0x41, 0x58,                                     // pop    r8
+		0x5A,                                           // pop    rdx
+		0x48, 0x85, 0xC0,                               // test   rax,rax
+		0x75, 0x05,                                     // jnz    relink
+		0x48, 0x8B, 0x44, 0x24, 0x08,                   // mov    rax,[first_block] <- out of memory, start over
+		0xE9, 0x5A, 0xFF, 0xFF, 0xFF,                   // jmp    link <- relink
+	};
+
+	static inline std::once_flag routineFlag{};
+	static inline void* routine = nullptr;
+};
+
 // The struct at the beginning of every hook instance.
 // It is entirely managed by the hooking system, 
 // setting these values yourself will certainly break things.
-struct HookBase {
+// The context type only decides what the pool is made of, the layout is the same for every hook.
+template <typename Context = HookContext> struct HookBaseTemplate {
+
+	// Selects the constructor leaving the hook without a pool, for hooks which never borrow contexts.
+	struct NoPool {};
+	static constexpr NoPool noPool{};
+
+	HookBaseTemplate(NoPool) {}
 
 	// The constructor sets up the context pool to be used by the assembly.
-	HookBase() {
-		this->poolEntryAllocator = std::make_unique<HookContext[]>(UNIHOOK_THREAD_ACCESS_LIMIT); // Allocate UNIHOOK_THREAD_ACCESS_LIMIT of HookContext structs.
-		this->poolArrayAllocator = std::make_unique<HookContext * []>(UNIHOOK_THREAD_ACCESS_LIMIT); // Allocate an array of UNIHOOK_THREAD_ACCESS_LIMIT HookContext pointers.
-		// Get the HookContext pointers into the respective struct.
-		for (int i = 0; i < UNIHOOK_THREAD_ACCESS_LIMIT; ++i) {
-			this->poolArrayAllocator.get()[i] = &this->poolEntryAllocator.get()[i];
+	// A pool stride wider than a pointer selects the padded layout used by HookBorrowStripedContext.
+	// The stubs of a hook borrowing contexts read the pool unconditionally, a stride of 0 is rejected rather than leaving it null.
+	HookBaseTemplate(size_t poolStride = sizeof(Context*)) {
+		if (!poolStride) throw std::invalid_argument("a hook borrowing contexts needs a pool");
+		if (poolStride > sizeof(Context*)) {
+			this->setupPaddedPool(poolStride);
+			return;
 		}
+
+		// The first block of a HookContextPool, the block header takes the first 4 pointers.
+		// One extra context leaves room for aligning the contexts to a cache line.
+		// the stubs call the pool's routine unconditionally once the first entry is taken
+		if (!HookContextPool::getRoutine()) throw std::bad_alloc();
+		const size_t count = HookContextPool::getInitialSize();
+		this->poolEntryAllocator = std::make_unique<Context[]>(count + 1);
+		this->poolArrayAllocator = std::make_unique<Context* []>(count + 4);
+
+		const uintptr_t entries = reinterpret_cast<uintptr_t>(this->poolEntryAllocator.get());
+		Context* contexts = reinterpret_cast<Context*>((entries + 63) & ~static_cast<uintptr_t>(63));
 		// Get the main pool pointer, accessing the std::unique_ptr pointer directly from assembly would be UB.
-		// Set up the offset in a way that simplifies the lookup loop and reduces branching.
-		this->pool = this->poolArrayAllocator.get() - 1;
+		this->pool = this->poolArrayAllocator.get() + 3;
+		HookContextPool::initBlock(reinterpret_cast<void**>(this->pool), contexts, count);
+	}
+
+	HookBaseTemplate(const HookBaseTemplate&) = delete;
+	HookBaseTemplate& operator=(const HookBaseTemplate&) = delete;
+
+	~HookBaseTemplate() {
+		if (this->usesContextPool()) HookContextPool::freeBlocks(reinterpret_cast<void**>(this->pool));
+	}
+
+	// Pads every pool entry to poolStride bytes and aligns every context to it, so no two threads share a cache line.
+	// The entry array is aligned to its own size, letting the assembly wrap around by masking the entry address.
+	void setupPaddedPool(size_t poolStride) {
+		const size_t poolSize = poolStride * UNIHOOK_THREAD_ACCESS_LIMIT;
+		// One extra context and twice the entry array size leave room for the alignment.
+		this->poolEntryAllocator = std::make_unique<Context[]>(UNIHOOK_THREAD_ACCESS_LIMIT + 1);
+		this->poolArrayAllocator = std::make_unique<Context* []>(2 * poolSize / sizeof(Context*));
+
+		const uintptr_t entries = reinterpret_cast<uintptr_t>(this->poolEntryAllocator.get());
+		const uintptr_t array = reinterpret_cast<uintptr_t>(this->poolArrayAllocator.get());
+		Context* contexts = reinterpret_cast<Context*>((entries + poolStride - 1) & ~(poolStride - 1));
+		this->pool = reinterpret_cast<Context**>((array + poolSize - 1) & ~(poolSize - 1));
+
+		for (int i = 0; i < UNIHOOK_THREAD_ACCESS_LIMIT; ++i) {
+			this->pool[i * poolStride / sizeof(Context*)] = &contexts[i];
+		}
+	}
+
+	// Tells whether every context is back in the pool, so no thread is using the hook's contexts.
+	// The pool stride must be the one the hook's Borrow type asks for, a hook which fell back to the default pool is recognized by its layout.
+	bool isPoolFull(size_t poolStride) const {
+		if (!this->pool) return true;
+		if (this->usesContextPool()) return HookContextPool::isFull(reinterpret_cast<void**>(this->pool));
+
+		const size_t step = poolStride / sizeof(Context*);
+		Context* const volatile* entries = this->pool;
+		for (int i = 0; i < UNIHOOK_THREAD_ACCESS_LIMIT; ++i) {
+			if (!entries[i * step]) return false;
+		}
+		return true;
+	}
+
+	// Tells whether the pool is a HookContextPool rather than the padded layout.
+	// The first entry of a padded pool holds a context, never the pool routine.
+	bool usesContextPool() const {
+		if (!this->pool || this->pool != this->poolArrayAllocator.get() + 3) return false;
+		return reinterpret_cast<void* const*>(this->pool)[0] == HookContextPool::getRoutine();
 	}
 
 	const unsigned long long magic = 0x6B6F6F48696E55ull; // magic: "UniHook\0".
 	std::shared_ptr<std::mutex> mutex = nullptr;
-	std::unique_ptr<HookContext[]> poolEntryAllocator; // Using a unique_ptr as a pseudoallocator.
-	std::unique_ptr<HookContext* []> poolArrayAllocator; // Storing raw pointers to each context entry in the pool in a single array.
-	HookContext** pool; // We don't want to access the unique_ptr pointer directly from assembly, doing so would be UB.
+	std::unique_ptr<Context[]> poolEntryAllocator; // Using a unique_ptr as a pseudoallocator.
+	std::unique_ptr<Context* []> poolArrayAllocator; // Storing raw pointers to each context entry in the pool in a single array.
+	Context** pool = nullptr; // We don't want to access the unique_ptr pointer directly from assembly, doing so would be UB.
 	void* previous = nullptr; // Pointer to the previous hook in a chain of hooks.
 	void* fnNew = nullptr; // Pointer to the user-defined hooking function.
 	void* fnHooked = nullptr; // Pointer to the hooked function.
 	void* extra = nullptr; // An extra pointer field, used mostly to store return addresses.
 };
 
+using HookBase = HookBaseTemplate<>;
+
+static_assert(sizeof(HookBaseTemplate<HookIntegerContext>) == sizeof(HookBase), "every hook shares the same data layout");
+
 // An assembly stub for retrieving a free context structure to use.
-// A pointer to the context pool array is expected in r10.
+// A pointer to the context pool is expected in r10, see HookContextPool.
 // The pointer to the context structure is returned in rax and saved in r12.
 // The old value of r12 is stored in the context.
-// If more than UNIHOOK_THREAD_ACCESS_LIMIT threads try to simultaneosly access the hook, the behavior is undefined.
+// Only the first entry is tried inline, the pool's routine probes the others and grows the pool if all of them are taken.
 struct alignas(1) HookBorrowContext {
+	static constexpr size_t poolStride = sizeof(HookContext*);
+
+	static size_t getPoolStride() noexcept { return HookBorrowContext::poolStride; }
+
 	uint8_t asmRaw[21] = {
 		0x31, 0xC0,                   // xor          eax,eax
-		0x4D, 0x8D, 0x52, 0x08,       // lea          r10,[r10+8] <- loop
-		0x49, 0x87, 0x02,             // xchg         [r10],rax
+		0x49, 0x87, 0x42, 0x08,       // xchg         [r10+8],rax
 		0x48, 0x85, 0xC0,             // test         rax,rax
-		0x74, 0xF4,                   // je           loop
-		0x4C, 0x89, 0x60, 0x60,       // mov          [reg64_r12],r12
+		0x75, 0x03,                   // jne          found
+		0x41, 0xFF, 0x12,             // call         [routine]
+		0x4C, 0x89, 0x60, 0x60,       // mov          [reg64_r12],r12 <- found
 		0x49, 0x89, 0xC4,             // mov          r12,rax
 	};
 };
 
 // An assembly stub for returning the context structure to the pool.
-// A pointer to the context pool array is expected in r10.
+// A pointer to the context pool is expected in r10, see HookContextPool.
 // The pointer to the context structure is expected in r12 as put there by the stub above.
-// If more than UNIHOOK_THREAD_ACCESS_LIMIT threads try to simultaneosly access the hook, the behavior is undefined.
+// Only the first entry is tried inline, the pool's routine finds a free entry otherwise.
 struct alignas(1) HookReturnContext {
 	uint8_t asmRaw[21] = {
 		0x4D, 0x89, 0xE3,             // mov          r11,r12
 		0x4D, 0x8B, 0x64, 0x24, 0x60, // mov          r12,[reg64_r12]
-		0x4D, 0x8D, 0x52, 0x08,       // lea          r10,[r10+8] <- loop
 		0x31, 0xC0,                   // xor          eax,eax
-		0xF0, 0x4D, 0x0F, 0xB1, 0x1A, // lock cmpxchg [r10],r11
-		0x75, 0xF3,                   // jne          continue
+		0xF0, 0x4D, 0x0F, 0xB1, 0x5A, 0x08, // lock cmpxchg [r10+8],r11
+		0x74, 0x03,                   // je           continue
+		0x41, 0xFF, 0x12,             // call         [routine]
+	};
+};
+
+// Per-thread context stacks used by the TLS hook variants (EntryHookTLS etc.).
+// Every hook shares a single TLS index; its TEB slot (gs:[0x1480+8*index]) points to the calling thread's stack.
+// Hooked calls on one thread are strictly nested, so contexts are pushed and popped without any atomics or thread limit.
+// A thread's stack is allocated the first time it enters such a hook and handed to a later thread when the thread exits.
+// Whenever the stack is unavailable or exhausted, the hook falls back to its pool like the default stubs do.
+class HookThreadContext {
+public:
+	/// <summary>
+	/// Static. Gets the shared context borrowing routine called by HookBorrowThreadContext, creating it on first use.
+	/// </summary>
+	/// <returns>a pointer to the executable routine, otherwise nullptr if it could not be created</returns>
+	static void* getBorrowRoutine()
+	{
+		std::call_once(HookThreadContext::routineFlag, HookThreadContext::createRoutines);
+		return HookThreadContext::borrowRoutine;
+	}
+
+	/// <summary>
+	/// Static. Gets the shared context returning routine called by HookReturnThreadContext, creating it on first use.
+	/// </summary>
+	/// <returns>a pointer to the executable routine, otherwise nullptr if it could not be created</returns>
+	static void* getReturnRoutine()
+	{
+		std::call_once(HookThreadContext::routineFlag, HookThreadContext::createRoutines);
+		return HookThreadContext::returnRoutine;
+	}
+
+	/// <summary>
+	/// Static. Gets the number of the latest sweep, see HookThreadContext::sweep.
+	/// </summary>
+	/// <returns>the number of the latest sweep, 0 before the first one</returns>
+	static uint64_t getSweep() noexcept { return HookThreadContext::sweeps.load(); }
+
+	/// <summary>
+	/// Static. Starts a new sweep, marking every thread stack which is not lending out any contexts at the moment.
+	/// A thread whose stack was marked in a sweep has left every TLS hook it was inside of before that sweep began.
+	/// </summary>
+	/// <returns>the oldest sweep every thread stack has been marked in since, i.e. the latest sweep none of the threads can still be inside a hook from</returns>
+	static uint64_t sweep()
+	{
+		std::lock_guard<std::mutex> lock(HookThreadContext::sweepMutex);
+
+		const uint64_t sweep = HookThreadContext::sweeps.load() + 1;
+		HookThreadContext::sweeps.store(sweep);
+
+		uint64_t oldest = sweep;
+		for (Stack* stack = HookThreadContext::stacks.load(); stack; stack = stack->next) {
+			const volatile uint64_t& free = stack->header.free;
+			if (free == UNIHOOK_THREAD_CONTEXT_DEPTH) stack->idleSweep = sweep;
+			else if (stack->idleSweep < oldest) oldest = stack->idleSweep;
+		}
+		return oldest;
+	}
+
+private:
+	// The part of a stack accessed by the routines, the TEB slot points to it.
+	struct StackHeader {
+		HookContext* top; // the next free context
+		uint64_t free; // the amount of free contexts
+	};
+
+	// Stacks are never freed, so they can be swept while their threads exit.
+	struct alignas(64) Stack {
+		StackHeader header;
+		Stack* next; // the next stack in HookThreadContext::stacks
+		std::atomic<bool> used;
+		uint64_t idleSweep; // the latest sweep the stack was marked in
+		alignas(64) HookContext contexts[UNIHOOK_THREAD_CONTEXT_DEPTH];
+	};
+
+	// Releases the stack of a thread when it exits, to be reused by other threads.
+	struct Owner {
+		~Owner()
+		{
+			if (this->stack) this->stack->used.store(false);
+			// hooks entered later on in the thread's teardown go straight to their pools
+			TlsSetValue(HookThreadContext::tlsIndex, &HookThreadContext::exhausted);
+		}
+
+		Stack* stack = nullptr;
+	};
+
+	// Called from the borrowing routine the first time a thread enters a hook, must not throw.
+	static StackHeader* __cdecl initThread() noexcept
+	{
+		static thread_local Owner owner{};
+
+		StackHeader* header = &HookThreadContext::exhausted;
+		if (Stack* stack = HookThreadContext::acquireStack()) {
+			stack->header.top = stack->contexts;
+			stack->header.free = UNIHOOK_THREAD_CONTEXT_DEPTH;
+			owner.stack = stack;
+			header = &stack->header;
+		}
+
+		TlsSetValue(HookThreadContext::tlsIndex, header);
+		return header;
+	}
+
+	// Takes the stack of an exited thread, or allocates a new one.
+	static Stack* acquireStack() noexcept
+	{
+		for (Stack* stack = HookThreadContext::stacks.load(); stack; stack = stack->next) {
+			bool used = false;
+			if (stack->used.compare_exchange_strong(used, true)) return stack;
+		}
+
+		Stack* stack = new(std::nothrow) Stack;
+		if (!stack) return nullptr;
+
+		stack->used.store(true);
+		stack->idleSweep = 0;
+		stack->next = HookThreadContext::stacks.load();
+		while (!HookThreadContext::stacks.compare_exchange_weak(stack->next, stack));
+		return stack;
+	}
+
+	static void createRoutines()
+	{
+		// the TEB only holds the first 64 slots inline, later ones are in a separately allocated expansion array
+		const DWORD index = TlsAlloc();
+		const bool tlsAvailable = index < 64;
+		if (!tlsAvailable && index != TLS_OUT_OF_INDEXES) TlsFree(index);
+		HookThreadContext::tlsIndex = tlsAvailable ? index : TLS_OUT_OF_INDEXES;
+
+		uint8_t* code = reinterpret_cast<uint8_t*>(VirtualAlloc(nullptr, 0x1000, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+		if (!code) return;
+
+		uint8_t* borrow = code;
+		uint8_t* ret = code + sizeof(HookThreadContext::borrowCode);
+		memcpy(borrow, HookThreadContext::borrowCode, sizeof(HookThreadContext::borrowCode));
+		memcpy(ret, HookThreadContext::returnCode, sizeof(HookThreadContext::returnCode));
+
+		if (tlsAvailable) {
+			const uint32_t slot = 0x1480 + index * sizeof(void*);
+			memcpy(borrow + 5, &slot, sizeof(slot));
+			memcpy(ret + 13, &slot, sizeof(slot));
+			auto pInitThread = &HookThreadContext::initThread;
+			memcpy(borrow + 0xAF, &pInitThread, sizeof(pInitThread));
+		}
+		else {
+			// no usable slot, both routines always use the pool
+			const uint8_t borrowFallback[9] = { 0xEB, 0x2F, 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 }; // jmp pooled, nop
+			const uint8_t returnFallback[9] = { 0x31, 0xC0, 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 }; // xor eax,eax, nop
+			memcpy(borrow, borrowFallback, sizeof(borrowFallback));
+			memcpy(ret + 8, returnFallback, sizeof(returnFallback));
+		}
+
+		DWORD oldProtect;
+		VirtualProtect(code, 0x1000, PAGE_EXECUTE_READ, &oldProtect);
+		FlushInstructionCache(GetCurrentProcess(), code, 0x1000);
+
+		HookThreadContext::borrowRoutine = borrow;
+		HookThreadContext::returnRoutine = ret;
+	}
+
+	// Same contract as HookBorrowContext, called instead of inlined. Only rax and r10 are clobbered.
+	static constexpr uint8_t borrowCode[183] = {
+		0x65, 0x48, 0x8B, 0x04, 0x25, 0x00, 0x00, 0x00, 0x00, // mov    rax,gs:[tls_slot]
+		0x48, 0x85, 0xC0,                               // test   rax,rax
+		0x74, 0x33,                                     // je     init
+		0x48, 0x83, 0x78, 0x08, 0x00,                   // cmp    [stack_free],0 <- fast
+		0x74, 0x1C,                                     // je     pooled
+		0x48, 0xFF, 0x48, 0x08,                         // dec    [stack_free]
+		0x48, 0x81, 0x00, 0x80, 0x02, 0x00, 0x00,       // add    [stack_top],sizeof(HookContext)
+		0x48, 0x8B, 0x00,                               // mov    rax,[stack_top]
+		0x48, 0x2D, 0x80, 0x02, 0x00, 0x00,             // sub    rax,sizeof(HookContext)
+		0x4C, 0x89, 0x60, 0x60,                         // mov    [reg64_r12],r12 <- done
+		0x49, 0x89, 0xC4,                               // mov    r12,rax
+		0xC3,                                           // ret
+		0x31, 0xC0,                                     // xor    eax,eax <- pooled
+		0x49, 0x87, 0x42, 0x08,                         // xchg   [r10+8],rax
+		0x48, 0x85, 0xC0,                               // test   rax,rax
+		0x75, 0xED,                                     // jne    done
+		0x41, 0xFF, 0x12,                               // call   [routine]
+		0xEB, 0xE8,                                     // jmp    done
+		0x51,                                           // push   rcx <- init
+		0x52,                                           // push   rdx
+		0x41, 0x50,                                     // push   r8
+		0x41, 0x51,                                     // push   r9
+		0x41, 0x52,                                     // push   r10
+		0x41, 0x53,                                     // push   r11
+		0x55,                                           // push   rbp
+		0x48, 0x89, 0xE5,                               // mov    rbp,rsp
+		0x48, 0x83, 0xE4, 0xF0,                         // and    rsp,-16
+		0x48, 0x81, 0xEC, 0x80, 0x00, 0x00, 0x00,       // sub    rsp,0x80
+		0x0F, 0x29, 0x44, 0x24, 0x20,                   // movaps [rsp+0x20],xmm0
+		0x0F, 0x29, 0x4C, 0x24, 0x30,                   // movaps [rsp+0x30],xmm1
+		0x0F, 0x29, 0x54, 0x24, 0x40,                   // movaps [rsp+0x40],xmm2
+		0x0F, 0x29, 0x5C, 0x24, 0x50,                   // movaps [rsp+0x50],xmm3
+		0x0F, 0x29, 0x64, 0x24, 0x60,                   // movaps [rsp+0x60],xmm4
+		0x0F, 0x29, 0x6C, 0x24, 0x70,                   // movaps [rsp+0x70],xmm5
+		0xFF, 0x15, 0x31, 0x00, 0x00, 0x00,             // call   [initThread]
+		0x0F, 0x28, 0x44, 0x24, 0x20,                   // movaps xmm0,[rsp+0x20]
+		0x0F, 0x28, 0x4C, 0x24, 0x30,                   // movaps xmm1,[rsp+0x30]
+		0x0F, 0x28, 0x54, 0x24, 0x40,                   // movaps xmm2,[rsp+0x40]
+		0x0F, 0x28, 0x5C, 0x24, 0x50,                   // movaps xmm3,[rsp+0x50]
+		0x0F, 0x28, 0x64, 0x24, 0x60,                   // movaps xmm4,[rsp+0x60]
+		0x0F, 0x28, 0x6C, 0x24, 0x70,                   // movaps xmm5,[rsp+0x70]
+		0x48, 0x89, 0xEC,                               // mov    rsp,rbp
+		0x5D,                                           // pop    rbp
+		0x41, 0x5B,                                     // pop    r11
+		0x41, 0x5A,                                     // pop    r10
+		0x41, 0x59,                                     // pop    r9
+		0x41, 0x58,                                     // pop    r8
+		0x5A,                                           // pop    rdx
+		0x59,                                           // pop    rcx
+		0xE9, 0x5F, 0xFF, 0xFF, 0xFF,                   // jmp    fast
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // initThread
+	};
+
+	// Same contract as HookReturnContext, called instead of inlined. Only rax, r10 and r11 are clobbered.
+	// Contexts are returned in the order they were borrowed in, so a context from the stack is always the last one taken.
+	static constexpr uint8_t returnCode[70] = {
+		0x4D, 0x89, 0xE3,                               // mov    r11,r12
+		0x4D, 0x8B, 0x64, 0x24, 0x60,                   // mov    r12,[reg64_r12]
+		0x65, 0x48, 0x8B, 0x04, 0x25, 0x00, 0x00, 0x00, 0x00, // mov    rax,gs:[tls_slot]
+		0x48, 0x85, 0xC0,                               // test   rax,rax
+		0x74, 0x22,                                     // je     pooled
+		0x49, 0x81, 0xC3, 0x80, 0x02, 0x00, 0x00,       // add    r11,sizeof(HookContext)
+		0x4C, 0x3B, 0x18,                               // cmp    r11,[stack_top]
+		0x75, 0x0F,                                     // jne    not_stack
+		0x49, 0x81, 0xEB, 0x80, 0x02, 0x00, 0x00,       // sub    r11,sizeof(HookContext)
+		0x4C, 0x89, 0x18,                               // mov    [stack_top],r11
+		0x48, 0xFF, 0x40, 0x08,                         // inc    [stack_free]
+		0xC3,                                           // ret
+		0x49, 0x81, 0xEB, 0x80, 0x02, 0x00, 0x00,       // sub    r11,sizeof(HookContext) <- not_stack
+		0x31, 0xC0,                                     // xor    eax,eax <- pooled
+		0xF0, 0x4D, 0x0F, 0xB1, 0x5A, 0x08,             // lock cmpxchg [r10+8],r11
+		0x74, 0x03,                                     // je     done
+		0x41, 0xFF, 0x22,                               // jmp    [routine]
+		0xC3,                                           // ret <- done
 	};
+
+	static inline StackHeader exhausted{}; // an always empty stack
+	static inline DWORD tlsIndex = TLS_OUT_OF_INDEXES;
+	static inline std::once_flag routineFlag{};
+	static inline void* borrowRoutine = nullptr;
+	static inline void* returnRoutine = nullptr;
+	static inline std::atomic<Stack*> stacks{ nullptr };
+	static inline std::atomic<uint64_t> sweeps{ 0 };
+	static inline std::mutex sweepMutex{};
 };
 
+// Calls the shared per-thread context borrowing routine, a drop-in replacement for HookBorrowContext.
+// Takes a context from the calling thread's stack, or from the pool in r10 if the stack is exhausted.
+// Falls back to the inlined pooled stub if the routine could not be created.
+struct alignas(1) HookBorrowThreadContext {
+	static constexpr size_t poolStride = sizeof(HookContext*);
+
+	static size_t getPoolStride() noexcept { return HookBorrowThreadContext::poolStride; }
+
+	HookBorrowThreadContext()
+	{
+		void* routine = HookThreadContext::getBorrowRoutine();
+		if (routine) memcpy(this->routine, &routine, sizeof(routine));
+		else {
+			const HookBorrowContext fallback{};
+			memcpy(this, &fallback, sizeof(fallback));
+		}
+	}
+
+	uint8_t asmRaw1[8] = {
+		0xFF, 0x15, 0x02, 0x00, 0x00, 0x00, // call         [routine]
+		0xEB, 0x0D,                         // jmp          continue
+	};
+	uint8_t routine[8]{};
+	uint8_t asmRaw2[5] = {
+		0x0F, 0x1F, 0x44, 0x00, 0x00,       // nop
+	};
+};
+
+// Calls the shared per-thread context returning routine, a drop-in replacement for HookReturnContext.
+// Contexts which did not come from the calling thread's stack are returned to the pool in r10.
+// Falls back to the inlined pooled stub if the routine could not be created.
+struct alignas(1) HookReturnThreadContext {
+	HookReturnThreadContext()
+	{
+		void* routine = HookThreadContext::getReturnRoutine();
+		if (routine) memcpy(this->routine, &routine, sizeof(routine));
+		else {
+			const HookReturnContext fallback{};
+			memcpy(this, &fallback, sizeof(fallback));
+		}
+	}
+
+	uint8_t asmRaw1[8] = {
+		0xFF, 0x15, 0x02, 0x00, 0x00, 0x00, // call         [routine]
+		0xEB, 0x0D,                         // jmp          continue
+	};
+	uint8_t routine[8]{};
+	uint8_t asmRaw2[5] = {
+		0x0F, 0x1F, 0x44, 0x00, 0x00,       // nop
+	};
+};
+
+static_assert(sizeof(HookBorrowThreadContext) == sizeof(HookBorrowContext), "the hook templates encode the stub size");
+static_assert(sizeof(HookReturnThreadContext) == sizeof(HookReturnContext), "the hook templates encode the stub size");
+
+// Shared routines for the striped hook variants (EntryHookStriped etc.), which use a padded pool layout.
+// Every pool entry is padded to Stride bytes - a cache line, or two for the adjacent line prefetcher -
+// and each thread starts probing at an entry picked by its thread id, wrapping around the pool,
+// so concurrent callers mostly touch separate, uncontended cache lines.
+// If all the entries are taken, callers keep probing until one is returned instead of running past the pool.
+template <size_t Stride> class HookStripedContext {
+public:
+	static_assert(Stride >= 64 && !(Stride & (Stride - 1)), "the stride must be a power of two of at least a cache line");
+	static_assert(!(UNIHOOK_THREAD_ACCESS_LIMIT & (UNIHOOK_THREAD_ACCESS_LIMIT - 1)), "the pool size must be a power of two");
+
+	/// <summary>
+	/// Static. Gets the shared context borrowing routine called by HookBorrowStripedContext, creating it on first use.
+	/// </summary>
+	/// <returns>a pointer to the executable routine, otherwise nullptr if it could not be created</returns>
+	static void* getBorrowRoutine()
+	{
+		std::call_once(HookStripedContext::routineFlag, HookStripedContext::createRoutines);
+		return HookStripedContext::borrowRoutine;
+	}
+
+	/// <summary>
+	/// Static. Gets the shared context returning routine called by HookReturnStripedContext, creating it on first use.
+	/// </summary>
+	/// <returns>a pointer to the executable routine, otherwise nullptr if it could not be created</returns>
+	static void* getReturnRoutine()
+	{
+		std::call_once(HookStripedContext::routineFlag, HookStripedContext::createRoutines);
+		return HookStripedContext::returnRoutine;
+	}
+
+private:
+	static constexpr uint32_t poolSize = Stride * UNIHOOK_THREAD_ACCESS_LIMIT;
+
+	// Thread ids are multiples of 4, (id / 4) * Stride is the starting entry offset.
+	static constexpr uint8_t stripeShift()
+	{
+		uint8_t shift = 0;
+		while ((4u << shift) < Stride) ++shift;
+		return shift;
+	}
+
+	static constexpr uint8_t byte(uint32_t value, int index) { return static_cast<uint8_t>(value >> index * 8); }
+
+	static void createRoutines()
+	{
+		uint8_t* code = reinterpret_cast<uint8_t*>(VirtualAlloc(nullptr, 0x1000, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+		if (!code) return;
+
+		memcpy(code, HookStripedContext::borrowCode, sizeof(HookStripedContext::borrowCode));
+		memcpy(code + sizeof(HookStripedContext::borrowCode), HookStripedContext::returnCode, sizeof(HookStripedContext::returnCode));
+
+		DWORD oldProtect;
+		VirtualProtect(code, 0x1000, PAGE_EXECUTE_READ, &oldProtect);
+		FlushInstructionCache(GetCurrentProcess(), code, 0x1000);
+
+		HookStripedContext::borrowRoutine = code;
+		HookStripedContext::returnRoutine = code + sizeof(HookStripedContext::borrowCode);
+	}
+
+	// Same contract as HookBorrowContext, except r10 holds the padded entry array. Only rax and r10 are clobbered.
+	static constexpr uint8_t borrowCode[62] = {
+		0x65, 0x8B, 0x04, 0x25, 0x48, 0x00, 0x00, 0x00, // mov    eax,gs:[thread_id]
+		0xC1, 0xE0, stripeShift(),                      // shl    eax,stripe_shift
+		0x25, byte(poolSize - Stride, 0), byte(poolSize - Stride, 1), byte(poolSize - Stride, 2), byte(poolSize - Stride, 3), // and eax,pool_size-Stride
+		0x49, 0x01, 0xC2,                               // add    r10,rax
+		0x31, 0xC0,                                     // xor    eax,eax <- loop
+		0x49, 0x87, 0x02,                               // xchg   [r10],rax
+		0x48, 0x85, 0xC0,                               // test   rax,rax
+		0x75, 0x19,                                     // jne    found
+		0x49, 0x81, 0xC2, byte(Stride, 0), byte(Stride, 1), byte(Stride, 2), byte(Stride, 3), // add r10,Stride
+		0x41, 0xF7, 0xC2, byte(poolSize - 1, 0), byte(poolSize - 1, 1), byte(poolSize - 1, 2), byte(poolSize - 1, 3), // test r10d,pool_size-1
+		0x75, 0xE6,                                     // jne    loop
+		0x49, 0x81, 0xEA, byte(poolSize, 0), byte(poolSize, 1), byte(poolSize, 2), byte(poolSize, 3), // sub r10,pool_size
+		0xEB, 0xDD,                                     // jmp    loop
+		0x4C, 0x89, 0x60, 0x60,                         // mov    [reg64_r12],r12 <- found
+		0x49, 0x89, 0xC4,                               // mov    r12,rax
+		0xC3,                                           // ret
+	};
+
+	// Same contract as HookReturnContext, except r10 holds the padded entry array. Only rax, r10 and r11 are clobbered.
+	static constexpr uint8_t returnCode[62] = {
+		0x4D, 0x89, 0xE3,                               // mov    r11,r12
+		0x4D, 0x8B, 0x64, 0x24, 0x60,                   // mov    r12,[reg64_r12]
+		0x65, 0x8B, 0x04, 0x25, 0x48, 0x00, 0x00, 0x00, // mov    eax,gs:[thread_id]
+		0xC1, 0xE0, stripeShift(),                      // shl    eax,stripe_shift
+		0x25, byte(poolSize - Stride, 0), byte(poolSize - Stride, 1), byte(poolSize - Stride, 2), byte(poolSize - Stride, 3), // and eax,pool_size-Stride
+		0x49, 0x01, 0xC2,                               // add    r10,rax
+		0x31, 0xC0,                                     // xor    eax,eax <- loop
+		0xF0, 0x4D, 0x0F, 0xB1, 0x1A,                   // lock cmpxchg [r10],r11
+		0x74, 0x19,                                     // je     done
+		0x49, 0x81, 0xC2, byte(Stride, 0), byte(Stride, 1), byte(Stride, 2), byte(Stride, 3), // add r10,Stride
+		0x41, 0xF7, 0xC2, byte(poolSize - 1, 0), byte(poolSize - 1, 1), byte(poolSize - 1, 2), byte(poolSize - 1, 3), // test r10d,pool_size-1
+		0x75, 0xE7,                                     // jne    loop
+		0x49, 0x81, 0xEA, byte(poolSize, 0), byte(poolSize, 1), byte(poolSize, 2), byte(poolSize, 3), // sub r10,pool_size
+		0xEB, 0xDE,                                     // jmp    loop
+		0xC3,                                           // ret <- done
+	};
+
+	static inline std::once_flag routineFlag{};
+	static inline void* borrowRoutine = nullptr;
+	static inline void* returnRoutine = nullptr;
+};
+
+// Calls the shared striped context borrowing routine, lays the hook's pool out with Stride bytes per entry.
+// Falls back to the default pool layout and the inlined pooled stub if the routine could not be created.
+// The choice is made by every hook as it is constructed and kept in its pool layout, see HookBaseTemplate::usesContextPool.
+template <size_t Stride = 64> struct alignas(1) HookBorrowStripedContext {
+	static constexpr size_t poolStride = Stride;
+
+	// The stride the hook's pool is laid out with, Stride if the routine is available, otherwise the default pool's.
+	// The routine is created once, so the hook's pool and its stubs always agree.
+	static size_t getPoolStride() { return HookStripedContext<Stride>::getBorrowRoutine() ? Stride : sizeof(HookContext*); }
+
+	HookBorrowStripedContext()
+	{
+		void* routine = HookStripedContext<Stride>::getBorrowRoutine();
+		if (routine) memcpy(this->routine, &routine, sizeof(routine));
+		else {
+			const HookBorrowContext fallback{};
+			memcpy(this, &fallback, sizeof(fallback));
+		}
+	}
+
+	uint8_t asmRaw1[8] = {
+		0xFF, 0x15, 0x02, 0x00, 0x00, 0x00, // call         [routine]
+		0xEB, 0x0D,                         // jmp          continue
+	};
+	uint8_t routine[8]{};
+	uint8_t asmRaw2[5] = {
+		0x0F, 0x1F, 0x44, 0x00, 0x00,       // nop
+	};
+};
+
+// Calls the shared striped context returning routine, the counterpart of HookBorrowStripedContext.
+// Falls back to the inlined pooled stub if the routine could not be created.
+template <size_t Stride = 64> struct alignas(1) HookReturnStripedContext {
+	HookReturnStripedContext()
+	{
+		void* routine = HookStripedContext<Stride>::getReturnRoutine();
+		if (routine) memcpy(this->routine, &routine, sizeof(routine));
+		else {
+			const HookReturnContext fallback{};
+			memcpy(this, &fallback, sizeof(fallback));
+		}
+	}
+
+	uint8_t asmRaw1[8] = {
+		0xFF, 0x15, 0x02, 0x00, 0x00, 0x00, // call         [routine]
+		0xEB, 0x0D,                         // jmp          continue
+	};
+	uint8_t routine[8]{};
+	uint8_t asmRaw2[5] = {
+		0x0F, 0x1F, 0x44, 0x00, 0x00,       // nop
+	};
+};
+
+static_assert(sizeof(HookBorrowStripedContext<>) == sizeof(HookBorrowContext), "the hook templates encode the stub size");
+static_assert(sizeof(HookReturnStripedContext<>) == sizeof(HookReturnContext), "the hook templates encode the stub size");
+
 // The default hook type.
 // The hooking function is executed before the hooked function.
 // The default Microsoft x86-64 calling convention is assumed: https://learn.microsoft.com/en-us/cpp/build/x64-calling-convention?view=msvc-170
 // Use EntryHookV for vectorcall functions.
-struct EntryHook {
-	EntryHook() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookIntegerContext> struct EntryHookTemplate {
+	EntryHookTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[7] = {
 	0x4C, 0x8B, 0x15, 0xD1, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[65] = {
 	0x48, 0x89, 0x48, 0x10,                   // mov    [reg64_rcx],rcx
 	0x48, 0x89, 0x50, 0x18,                   // mov    [reg64_rdx],rdx
@@ -147,7 +907,7 @@ struct EntryHook {
 	0xFF, 0x30,                               // push   [reg64_rax]
 	0x4C, 0x8B, 0x15, 0x7B, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[6] = {
 	0xFF, 0x25, 0x78, 0xFF, 0xFF, 0xFF,       // jmp    [fnHooked]
 	};
@@ -157,17 +917,17 @@ struct EntryHook {
 // The return value of the hooked function is preserved, use ReturnHook to override it.
 // The default Microsoft x86-64 calling convention is assumed: https://learn.microsoft.com/en-us/cpp/build/x64-calling-convention?view=msvc-170
 // Use ExitHookV for vectorcall functions.
-struct ExitHook {
-	ExitHook() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookIntegerContext> struct ExitHookTemplate {
+	ExitHookTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[7] = {
 	0x4C, 0x8B, 0x15, 0xD1, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[80] = {
 	0x48, 0x89, 0x48, 0x10,                   // mov    [reg64_rcx],rcx
 	0x48, 0x89, 0x50, 0x18,                   // mov    [reg64_rdx],rdx
@@ -189,7 +949,7 @@ struct ExitHook {
 	0xFF, 0x30,                               // push   [rax]
 	0x4C, 0x8B, 0x15, 0x6C, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[2] = {
 	0x58,                                     // pop rax
 	0xC3,                                     // ret
@@ -200,17 +960,17 @@ struct ExitHook {
 // The return value of the hooked function is overriden, make your hooking function has a fitting return value.
 // The default Microsoft x86-64 calling convention is assumed: https://learn.microsoft.com/en-us/cpp/build/x64-calling-convention?view=msvc-170
 // Use ReturnHookV for vectorcall functions.
-struct ReturnHook {
-	ReturnHook() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookIntegerContext> struct ReturnHookTemplate {
+	ReturnHookTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[7] = {
 	0x4C, 0x8B, 0x15, 0xD1, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[65] = {
 	0x48, 0x89, 0x48, 0x10,                   // mov    [reg64_rcx],rcx
 	0x48, 0x89, 0x50, 0x18,                   // mov    [reg64_rdx],rdx
@@ -228,31 +988,31 @@ struct ReturnHook {
 	0xFF, 0x30,                               // push   [reg64_rax]
 	0x4C, 0x8B, 0x15, 0x7B, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[6] = {
 	0xFF, 0x25, 0x70, 0xFF, 0xFF, 0xFF,       // jmp    [fnNew]
 	};
 };
 
 // A template for completely overriding the hooked function with the hooking function.
-// The integer callee context is preserved in a HookContext structure and passed as the first argument to the hooking function.
+// The integer callee context is preserved in a HookIntegerContext structure and passed as the first argument to the hooking function.
 // The second argument passed to the hooking function is a pointer to the hooked function.
 // From within the hooking function, you may call the original function through its pointer, do it conditionally or not at all.
 // Hooking function signature:
-// intptr_t (*)(HookContext*, void*)
+// intptr_t (*)(HookIntegerContext*, void*)
 // Does not include SIMD registers, use OverrideHookV for that.
-struct OverrideHook {
-	OverrideHook() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookIntegerContext> struct OverrideHookTemplate {
+	OverrideHookTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[9] = {
 	0x41, 0x52,                                     // push   r10
 	0x4C, 0x8B, 0x15, 0xCF, 0xFF, 0xFF, 0xFF,       // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[149] = {
 	0x48, 0x89, 0x58, 0x08,                         // mov    [reg64_rbx],rbx
 	0x48, 0x89, 0x48, 0x10,                         // mov    [reg64_rcx],rcx
@@ -292,7 +1052,7 @@ struct OverrideHook {
 	0x4C, 0x8B, 0x78, 0x78,                         // mov    r15,[reg64_r15]
 	0x4C, 0x8B, 0x15, 0x25, 0xFF, 0xFF, 0xFF,       // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[2] = {
 	0x58,                                           // pop    rax
 	0xC3,                                           // ret
@@ -303,20 +1063,20 @@ struct OverrideHook {
 // then passes a pointer to it to the hooking function as its first parameter.
 // This allows modifying any register by accessing them inside the struct.
 // Hooking function signature:
-// void (*)(HookContext*)
+// void (*)(HookIntegerContext*)
 // Does not include SIMD registers, use ContextHookV for that.
-struct ContextHook {
-	ContextHook() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookIntegerContext> struct ContextHookTemplate {
+	ContextHookTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[9] = {
 	0x41, 0x52,                                     // push   r10
 	0x4C, 0x8B, 0x15, 0xCF, 0xFF, 0xFF, 0xFF,       // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[139] = {
 	0x48, 0x89, 0x58, 0x08,                         // mov    [reg64_rbx],rbx
 	0x48, 0x89, 0x48, 0x10,                         // mov    [reg64_rcx],rcx
@@ -354,7 +1114,7 @@ struct ContextHook {
 	0xFF, 0x30,                                     // push   [reg64_rax]
 	0x4C, 0x8B, 0x15, 0x2F, 0xFF, 0xFF, 0xFF,       // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[6] = {
 	0xFF, 0x25, 0x2C, 0xFF, 0xFF, 0xFF,             // jmp    [fnHooked]
 	};
@@ -363,17 +1123,17 @@ struct ContextHook {
 // The hooking function is executed before the hooked function.
 // The vectorcall Microsoft calling convention is assumed: https://learn.microsoft.com/en-us/cpp/cpp/vectorcall?view=msvc-170
 // Can be used for non-vectorcall functions, however it would be unnecessary and slower than normal EntryHook.
-struct EntryHookV {
-	EntryHookV() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookContext> struct EntryHookVTemplate {
+	EntryHookVTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[7] = {
 	0x4C, 0x8B, 0x15, 0xD1, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[149] = {
 	0x48, 0x89, 0x48, 0x10,                   // mov    [reg64_rcx],rcx
 	0x48, 0x89, 0x50, 0x18,                   // mov    [reg64_rdx],rdx
@@ -403,7 +1163,7 @@ struct EntryHookV {
 	0xFF, 0x30,                               // push   [reg64_rax]
 	0x4C, 0x8B, 0x15, 0x27, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[6] = {
 	0xFF, 0x25, 0x24, 0xFF, 0xFF, 0xFF,       // jmp    [fnHooked]
 	};
@@ -413,17 +1173,17 @@ struct EntryHookV {
 // The return value of the hooked function is preserved, use ReturnHookV to override it.
 // The vectorcall Microsoft calling convention is assumed: https://learn.microsoft.com/en-us/cpp/cpp/vectorcall?view=msvc-170
 // Can be used for non-vectorcall functions, however it would be unnecessary and slower than normal ExitHook.
-struct ExitHookV {
-	ExitHookV() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookContext> struct ExitHookVTemplate {
+	ExitHookVTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[7] = {
 	0x4C, 0x8B, 0x15, 0xD1, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[221] = {
 	0x48, 0x89, 0x48, 0x10,                   // mov    [reg64_rcx],rcx
 	0x48, 0x89, 0x50, 0x18,                   // mov    [reg64_rdx],rdx
@@ -465,7 +1225,7 @@ struct ExitHookV {
 	0xFF, 0x30,                               // push   [rax]
 	0x4C, 0x8B, 0x15, 0xDF, 0xFE, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[2] = {
 	0x58,                                     // pop rax
 	0xC3,                                     // ret
@@ -476,17 +1236,17 @@ struct ExitHookV {
 // The return value of the hooked function is overriden, make your hooking function has a fitting return value.
 // The vectorcall Microsoft calling convention is assumed: https://learn.microsoft.com/en-us/cpp/cpp/vectorcall?view=msvc-170
 // Can be used for non-vectorcall functions, however it would be unnecessary and slower than normal ReturnHook.
-struct ReturnHookV {
-	ReturnHookV() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookContext> struct ReturnHookVTemplate {
+	ReturnHookVTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[7] = {
 	0x4C, 0x8B, 0x15, 0xD1, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[149] = {
 	0x48, 0x89, 0x48, 0x10,                   // mov    [reg64_rcx],rcx
 	0x48, 0x89, 0x50, 0x18,                   // mov    [reg64_rdx],rdx
@@ -516,7 +1276,7 @@ struct ReturnHookV {
 	0xFF, 0x30,                               // push   [reg64_rax]
 	0x4C, 0x8B, 0x15, 0x27, 0xFF, 0xFF, 0xFF, // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[6] = {
 	0xFF, 0x25, 0x1C, 0xFF, 0xFF, 0xFF,       // jmp    [fnNew]
 	};
@@ -529,18 +1289,18 @@ struct ReturnHookV {
 // Hooking function signature:
 // intptr_t (*)(HookContext*, void*)
 // Use OverrideHook if you only need the integer register context.
-struct OverrideHookV {
-	OverrideHookV() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookContext> struct OverrideHookVTemplate {
+	OverrideHookVTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[9] = {
 	0x41, 0x52,                                     // push   r10
 	0x4C, 0x8B, 0x15, 0xCF, 0xFF, 0xFF, 0xFF,       // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[361] = {
 	0x48, 0x89, 0x58, 0x08,                         // mov    [reg64_rbx],rbx
 	0x48, 0x89, 0x48, 0x10,                         // mov    [reg64_rcx],rcx
@@ -608,7 +1368,7 @@ struct OverrideHookV {
 	0x44, 0x0F, 0x28, 0xB8, 0x60, 0x02, 0x00, 0x00, // movaps xmm15,[imm256_xmm15]
 	0x4C, 0x8B, 0x15, 0x51, 0xFE, 0xFF, 0xFF,       // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[2] = {
 	0x58,                                           // pop    rax
 	0xC3,                                           // ret
@@ -622,18 +1382,18 @@ struct OverrideHookV {
 // void (*)(HookContext*)
 // Includes SIMD registers (and is therefore quite large). 
 // Use ContextHook if you only need the integer register context.
-struct ContextHookV {
-	ContextHookV() {}
+template <typename Borrow = HookBorrowContext, typename Return = HookReturnContext, typename Context = HookContext> struct ContextHookVTemplate {
+	ContextHookVTemplate() {}
 
 	//data:
-	HookBase hookData{};
+	HookBaseTemplate<Context> hookData{ Borrow::getPoolStride() };
 
 	// assembly:
 	uint8_t asmRaw1[9] = {
 	0x41, 0x52,                                     // push   r10
 	0x4C, 0x8B, 0x15, 0xCF, 0xFF, 0xFF, 0xFF,       // mov    r10,[pool]
 	};
-	HookBorrowContext asmBorrow{};
+	Borrow asmBorrow{};
 	uint8_t asmRaw2[379] = {
 	0x48, 0x89, 0x58, 0x08,                         // mov    [reg64_rbx],rbx
 	0x48, 0x89, 0x48, 0x10,                         // mov    [reg64_rcx],rcx
@@ -703,10 +1463,285 @@ struct ContextHookV {
 	0xFF, 0x30,                                     // push   [reg64_rax]
 	0x4C, 0x8B, 0x15, 0x3F, 0xFE, 0xFF, 0xFF,       // mov    r10,[pool]
 	};
-	HookReturnContext asmReturn{};
+	Return asmReturn{};
 	uint8_t asmRaw3[6] = {
 	0xFF, 0x25, 0x3C, 0xFE, 0xFF, 0xFF,             // jmp    [fnHooked]
 	};
 };
 
+// A hook that replaces the hooked function with the hooking function, with no assembly in between.
+// The hooking function has the same signature as the hooked function and calls the original function itself,
+// through the trampoline received when placing the hook (see VFTHookTemplate), conditionally or not at all.
+// Takes part in hook chains like every other hook, the trampoline always leads to the next function in the chain.
+// No contexts or atomics are involved: a hooked call costs one extra indirect jump, and one more to reach the original function.
+// For the same reason an unhooked instance cannot tell when it is no longer used, it is only freed after HookReclaimer::releaseThunks.
+struct ThunkHook {
+	ThunkHook() {}
+
+	//data:
+	HookBaseTemplate<HookIntegerContext> hookData{ HookBaseTemplate<HookIntegerContext>::noPool };
+
+	// assembly:
+	uint8_t asmRaw1[6] = {
+	0xFF, 0x25, 0xE2, 0xFF, 0xFF, 0xFF,       // jmp    [fnNew]
+	};
+	uint8_t asmTrampoline[6] = {
+	0xFF, 0x25, 0xE4, 0xFF, 0xFF, 0xFF,       // jmp    [fnHooked]
+	};
+};
+
+// Call statistics of an instrumented hook, see InstrumentedHook.
+// Split into cache line sized stripes, each thread only updates its own stripe so the counters don't contend.
+struct HookStats {
+	static constexpr size_t stripeCount = 16;
+
+	struct alignas(64) Stripe {
+		std::atomic<uint64_t> calls;
+		std::atomic<uint64_t> cycles; // rdtsc ticks spent in the hook function
+		std::atomic<uint64_t> maxCycles;
+		std::atomic<int64_t> active; // measured calls in progress
+	};
+
+	// Marks a call in progress on a stripe.
+	void begin(size_t stripe) noexcept {
+		this->stripes[stripe % HookStats::stripeCount].active.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Adds a finished call to a stripe.
+	void record(size_t stripe, uint64_t cycles) noexcept {
+		Stripe& target = this->stripes[stripe % HookStats::stripeCount];
+		target.active.fetch_sub(1, std::memory_order_relaxed);
+		target.calls.fetch_add(1, std::memory_order_relaxed);
+		target.cycles.fetch_add(cycles, std::memory_order_relaxed);
+
+		uint64_t maxCycles = target.maxCycles.load(std::memory_order_relaxed);
+		while (cycles > maxCycles && !target.maxCycles.compare_exchange_weak(maxCycles, cycles, std::memory_order_relaxed));
+	}
+
+	// Clears every stripe. Calls in progress are counted after the reset.
+	void reset() noexcept {
+		for (Stripe& stripe : this->stripes) {
+			stripe.calls.store(0, std::memory_order_relaxed);
+			stripe.cycles.store(0, std::memory_order_relaxed);
+			stripe.maxCycles.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// Tells whether no measured call is in progress, i.e. no thread will return to the trampoline.
+	bool isIdle() const noexcept {
+		int64_t active = 0;
+		for (const Stripe& stripe : this->stripes) active += stripe.active.load();
+		return !active;
+	}
+
+	Stripe stripes[HookStats::stripeCount];
+};
+
+// The routines called by the trampoline of an instrumented hook, before and after the hook function.
+// Every thread keeps the return addresses and start times of the instrumented calls it is inside of,
+// so the trampoline never changes the stack the hook function sees.
+// Calls nested deeper than UNIHOOK_THREAD_CONTEXT_DEPTH are not measured.
+class HookInstrumentation {
+public:
+	// Called before the hook function, records the call and its start time. Returns false if the call is not measured.
+	static bool __cdecl enter(HookStats* stats, void* returnAddress) noexcept {
+		Thread& thread = HookInstrumentation::getThread();
+		if (thread.depth == UNIHOOK_THREAD_CONTEXT_DEPTH) return false;
+
+		Frame& frame = thread.frames[thread.depth++];
+		frame.returnAddress = returnAddress;
+		frame.stats = stats;
+		stats->begin(thread.stripe);
+		frame.start = __rdtsc();
+		return true;
+	}
+
+	// Called after a measured hook function has returned, adds the call to its stats. Returns the original return address.
+	static void* __cdecl leave() noexcept {
+		const uint64_t end = __rdtsc();
+
+		Thread& thread = HookInstrumentation::getThread();
+		Frame& frame = thread.frames[--thread.depth];
+		frame.stats->record(thread.stripe, end - frame.start);
+		return frame.returnAddress;
+	}
+
+private:
+	struct Frame {
+		void* returnAddress;
+		HookStats* stats;
+		uint64_t start;
+	};
+
+	struct Thread {
+		Frame frames[UNIHOOK_THREAD_CONTEXT_DEPTH];
+		size_t depth;
+		size_t stripe;
+	};
+
+	static Thread& getThread() noexcept {
+		static thread_local Thread thread{ {}, 0, HookInstrumentation::nextStripe.fetch_add(1, std::memory_order_relaxed) };
+		return thread;
+	}
+
+	static inline std::atomic<size_t> nextStripe{ 0 };
+};
+
+// An instrumented variant of any hook type, counting the calls to the hook function and the rdtsc ticks spent in it.
+// The hook's fnNew points to a trampoline which calls HookInstrumentation around the hook function,
+// the hook type's own assembly is left as it is and hooks without instrumentation are unaffected.
+// The trampoline preserves the argument registers (including xmm0-xmm5 for vectorcall) and the return registers (rax, xmm0-xmm3).
+// The stats of live hooks are read through HookProfiler::snapshot.
+// Threads returning to the trampoline are counted in the stats, keeping an unhooked instance alive until they are done (see HookReclaimer).
+// Calls which are not measured do not return to the trampoline and are not counted, see HookQuiescence.
+template <typename Hook> struct InstrumentedHook : Hook {
+	InstrumentedHook() {
+		memcpy(this->asmInstrument.code, InstrumentedHook::trampolineCode, sizeof(InstrumentedHook::trampolineCode));
+		this->asmInstrument.stats = this->stats.get();
+		this->asmInstrument.enter = reinterpret_cast<void*>(&HookInstrumentation::enter);
+		this->asmInstrument.leave = reinterpret_cast<void*>(&HookInstrumentation::leave);
+	}
+
+	// Routes the hook function through the trampoline, used instead of setting fnNew.
+	void setFunction(void* function) {
+		this->asmInstrument.target = function;
+		this->hookData.fnNew = this->asmInstrument.code;
+	}
+
+	// Tells whether no thread is inside of the hook function through the trampoline.
+	bool isIdle() const {
+		return this->stats->isIdle();
+	}
+
+	// data:
+	std::unique_ptr<HookStats> stats = std::make_unique<HookStats>(); // kept apart from the executable hook memory
+
+	// assembly:
+	struct alignas(8) {
+		uint8_t code[0xC0];
+		HookStats* stats;
+		void* enter;
+		void* leave;
+		void* target; // the hook function
+	} asmInstrument{};
+
+private:
+	static constexpr uint8_t trampolineCode[0xC0] = {
+		0x51,                                           // push   rcx
+		0x52,                                           // push   rdx
+		0x41, 0x50,                                     // push   r8
+		0x41, 0x51,                                     // push   r9
+		0x48, 0x81, 0xEC, 0x88, 0x00, 0x00, 0x00,       // sub    rsp,0x88
+		0x0F, 0x29, 0x44, 0x24, 0x20,                   // movaps [rsp+0x20],xmm0
+		0x0F, 0x29, 0x4C, 0x24, 0x30,                   // movaps [rsp+0x30],xmm1
+		0x0F, 0x29, 0x54, 0x24, 0x40,                   // movaps [rsp+0x40],xmm2
+		0x0F, 0x29, 0x5C, 0x24, 0x50,                   // movaps [rsp+0x50],xmm3
+		0x0F, 0x29, 0x64, 0x24, 0x60,                   // movaps [rsp+0x60],xmm4
+		0x0F, 0x29, 0x6C, 0x24, 0x70,                   // movaps [rsp+0x70],xmm5
+		0x48, 0x8B, 0x0D, 0x8E, 0x00, 0x00, 0x00,       // mov    rcx,[stats]
+		0x48, 0x8B, 0x94, 0x24, 0xA8, 0x00, 0x00, 0x00, // mov    rdx,[old_return]
+		0xFF, 0x15, 0x88, 0x00, 0x00, 0x00,             // call   [enter]
+		0x0F, 0x28, 0x44, 0x24, 0x20,                   // movaps xmm0,[rsp+0x20]
+		0x0F, 0x28, 0x4C, 0x24, 0x30,                   // movaps xmm1,[rsp+0x30]
+		0x0F, 0x28, 0x54, 0x24, 0x40,                   // movaps xmm2,[rsp+0x40]
+		0x0F, 0x28, 0x5C, 0x24, 0x50,                   // movaps xmm3,[rsp+0x50]
+		0x0F, 0x28, 0x64, 0x24, 0x60,                   // movaps xmm4,[rsp+0x60]
+		0x0F, 0x28, 0x6C, 0x24, 0x70,                   // movaps xmm5,[rsp+0x70]
+		0x48, 0x81, 0xC4, 0x88, 0x00, 0x00, 0x00,       // add    rsp,0x88
+		0x41, 0x59,                                     // pop    r9
+		0x41, 0x58,                                     // pop    r8
+		0x5A,                                           // pop    rdx
+		0x59,                                           // pop    rcx
+		0x84, 0xC0,                                     // test   al,al
+		0x74, 0x0B,                                     // je     direct
+		0x48, 0x8D, 0x05, 0x0A, 0x00, 0x00, 0x00,       // lea    rax,[new_return]
+		0x48, 0x89, 0x04, 0x24,                         // mov    [old_return],rax
+		0xFF, 0x25, 0x58, 0x00, 0x00, 0x00,             // jmp    [target] <- direct
+		0x50,                                           // push   rax <- new_return
+		0x48, 0x83, 0xEC, 0x68,                         // sub    rsp,0x68
+		0x0F, 0x29, 0x44, 0x24, 0x20,                   // movaps [rsp+0x20],xmm0
+		0x0F, 0x29, 0x4C, 0x24, 0x30,                   // movaps [rsp+0x30],xmm1
+		0x0F, 0x29, 0x54, 0x24, 0x40,                   // movaps [rsp+0x40],xmm2
+		0x0F, 0x29, 0x5C, 0x24, 0x50,                   // movaps [rsp+0x50],xmm3
+		0xFF, 0x15, 0x31, 0x00, 0x00, 0x00,             // call   [leave]
+		0x49, 0x89, 0xC3,                               // mov    r11,rax
+		0x0F, 0x28, 0x44, 0x24, 0x20,                   // movaps xmm0,[rsp+0x20]
+		0x0F, 0x28, 0x4C, 0x24, 0x30,                   // movaps xmm1,[rsp+0x30]
+		0x0F, 0x28, 0x54, 0x24, 0x40,                   // movaps xmm2,[rsp+0x40]
+		0x0F, 0x28, 0x5C, 0x24, 0x50,                   // movaps xmm3,[rsp+0x50]
+		0x48, 0x83, 0xC4, 0x68,                         // add    rsp,0x68
+		0x58,                                           // pop    rax
+		0x41, 0xFF, 0xE3,                               // jmp    r11
+		0xCC, 0xCC,                                     // int3
+	};
+};
+
+template <typename Hook> inline constexpr bool isInstrumentedHook = false;
+template <typename Hook> inline constexpr bool isInstrumentedHook<InstrumentedHook<Hook>> = true;
+
+// Tells whether a hook type only calls its hook function ahead of the hooked function, so that a run of them can be flattened, see HookChainCompiler.
+template <typename Hook> inline constexpr bool isEntryHook = false;
+template <typename Borrow, typename Return, typename Context> inline constexpr bool isEntryHook<EntryHookTemplate<Borrow, Return, Context>> = true;
+template <typename Borrow, typename Return, typename Context> inline constexpr bool isEntryHook<EntryHookVTemplate<Borrow, Return, Context>> = true;
+template <typename Hook> inline constexpr bool isVectorEntryHook = false;
+template <typename Borrow, typename Return, typename Context> inline constexpr bool isVectorEntryHook<EntryHookVTemplate<Borrow, Return, Context>> = true;
+
+// Tells whether a thread may still be using a hook instance, for reclaiming unhooked instances.
+// A hook is quiescent once every context it lent out has been given back: to its pool, and for the TLS variants to every thread's stack.
+// Threads in the few instructions before a context is borrowed or after it is returned are not seen, see HookReclaimer.
+// Hooks which cannot tell at all need an explicit release, see HookReclaimer::releaseThunks.
+// A ThunkHook has no contexts, a thread inside of its hook function is only seen once it jumps through the trampoline.
+// The same holds for an instrumented one, its stats do not count calls nested deeper than UNIHOOK_THREAD_CONTEXT_DEPTH.
+template <typename Hook, typename = void> struct HookQuiescence {
+	static constexpr bool usesThreadStacks = false;
+	static constexpr bool needsRelease = std::is_base_of_v<ThunkHook, Hook>;
+	static bool isPoolFull(const Hook& hook) { return true; }
+};
+
+template <typename Hook> struct HookQuiescence<Hook, std::void_t<decltype(Hook::asmBorrow)>> {
+	using Borrow = decltype(Hook::asmBorrow);
+	static constexpr bool usesThreadStacks = std::is_same_v<Borrow, HookBorrowThreadContext>;
+	static constexpr bool needsRelease = false;
+	static bool isPoolFull(const Hook& hook) { return hook.hookData.isPoolFull(Borrow::poolStride); }
+};
+
+// Hook types borrowing their contexts from the hook's pool.
+using EntryHook = EntryHookTemplate<>;
+using ExitHook = ExitHookTemplate<>;
+using ReturnHook = ReturnHookTemplate<>;
+using OverrideHook = OverrideHookTemplate<>;
+using ContextHook = ContextHookTemplate<>;
+using EntryHookV = EntryHookVTemplate<>;
+using ExitHookV = ExitHookVTemplate<>;
+using ReturnHookV = ReturnHookVTemplate<>;
+using OverrideHookV = OverrideHookVTemplate<>;
+using ContextHookV = ContextHookVTemplate<>;
+
+// Hook types borrowing their contexts from the calling thread's context stack, see HookThreadContext.
+// Interchangeable with the pooled hook types, including in hook chains.
+using EntryHookTLS = EntryHookTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using ExitHookTLS = ExitHookTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using ReturnHookTLS = ReturnHookTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using OverrideHookTLS = OverrideHookTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using ContextHookTLS = ContextHookTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using EntryHookVTLS = EntryHookVTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using ExitHookVTLS = ExitHookVTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using ReturnHookVTLS = ReturnHookVTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using OverrideHookVTLS = OverrideHookVTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+using ContextHookVTLS = ContextHookVTemplate<HookBorrowThreadContext, HookReturnThreadContext>;
+
+// Hook types borrowing their contexts from a padded pool with a per-thread starting entry, see HookStripedContext.
+// For a 128 byte stride, instantiate the templates with HookBorrowStripedContext<128> and HookReturnStripedContext<128>.
+using EntryHookStriped = EntryHookTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using ExitHookStriped = ExitHookTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using ReturnHookStriped = ReturnHookTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using OverrideHookStriped = OverrideHookTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using ContextHookStriped = ContextHookTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using EntryHookVStriped = EntryHookVTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using ExitHookVStriped = ExitHookVTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using ReturnHookVStriped = ReturnHookVTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using OverrideHookVStriped = OverrideHookVTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+using ContextHookVStriped = ContextHookVTemplate<HookBorrowStripedContext<>, HookReturnStripedContext<>>;
+
 #undef UNIHOOK_THREAD_ACCESS_LIMIT
+#undef UNIHOOK_THREAD_CONTEXT_DEPTH
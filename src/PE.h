@@ -19,6 +19,7 @@ public:
 		HANDLE hProcess;
 		HMODULE hProcessModule;
 		std::unique_ptr<MODULEINFO> mInfo;
+		std::string imagePath; // path of the image file if it is not loaded as a module (see PEParser::MappedImage), otherwise empty
 	};
 
 	static std::shared_ptr<ProcessInfo> getProcessInfo() { return pInfo; }
@@ -151,12 +152,119 @@ public:
 		size_t size;
 		ibo32 start;
 		ibo32 end;
+		unsigned int characteristics; // IMAGE_SCN_* flags of the section header
 	};
 
 	typedef std::vector<std::unique_ptr<PEParser::Section>> PESections;
 
+	/// <summary>
+	/// A flat table of [start, end) ranges of all sections sharing a name, sorted by start.
+	/// Ranges are stored as offsets from a single precomputed base address,
+	/// which makes membership tests a subtraction and an unsigned comparison per range.
+	/// </summary>
+	class SectionRanges {
+	public:
+		struct Range {
+			uintptr_t start;
+			uintptr_t size;
+		};
+
+		SectionRanges(uintptr_t base = 0) : base(base) {}
+
+		/// <summary>
+		/// Internal function. Inserts a range, keeping the table sorted by start offset.
+		/// </summary>
+		/// <param name="start">: offset of the range start from the base address</param>
+		/// <param name="size">: size of the range in bytes</param>
+		void addRange(uintptr_t start, uintptr_t size)
+		{
+			auto iter = this->ranges.begin();
+			while (iter != this->ranges.end() && iter->start < start) ++iter;
+			this->ranges.insert(iter, { start, size });
+		}
+
+		/// <summary>
+		/// Checks if an offset from the base address is inside any of the ranges.
+		/// </summary>
+		/// <param name="offset">: the offset to be checked</param>
+		/// <returns>true if offset is in one of the ranges, otherwise false</returns>
+		bool containsOffset(uintptr_t offset) const noexcept
+		{
+			// unsigned wraparound turns offsets below the range start into very large values,
+			// so a single comparison covers both bounds
+			bool result = false;
+			for (const Range& range : this->ranges) {
+				result |= offset - range.start < range.size;
+			}
+			return result;
+		}
+
+		/// <summary>
+		/// Checks if a given address is inside any of the ranges.
+		/// </summary>
+		/// <param name="address">: the address to be checked</param>
+		/// <returns>true if address is in one of the ranges, otherwise false</returns>
+		template <typename T> bool contains(T* address) const noexcept
+		{
+			return this->containsOffset(reinterpret_cast<uintptr_t>(address) - this->base);
+		}
+
+		/// <summary>
+		/// Checks if a given integer base offset is inside any of the ranges.
+		/// </summary>
+		/// <param name="ibo">: the ibo to be checked</param>
+		/// <returns>true if ibo is in one of the ranges, otherwise false</returns>
+		bool contains(ibo32 ibo) const noexcept
+		{
+			// negative ibos become very large offsets and are rejected
+			return this->containsOffset(static_cast<uintptr_t>(static_cast<unsigned int>(ibo.as())));
+		}
+
+		/// <summary>
+		/// Retrieves the number of bytes from a given address to the end of the range containing it.
+		/// </summary>
+		/// <param name="address">: the address to be checked</param>
+		/// <returns>the number of readable bytes at address, 0 if it is not in any of the ranges</returns>
+		template <typename T> uintptr_t getRemaining(T* address) const noexcept
+		{
+			const uintptr_t offset = reinterpret_cast<uintptr_t>(address) - this->base;
+			for (const Range& range : this->ranges) {
+				if (offset - range.start < range.size) return range.start + range.size - offset;
+			}
+			return 0;
+		}
+
+		uintptr_t getBase() const noexcept { return this->base; }
+		const std::vector<Range>& getRanges() const noexcept { return this->ranges; }
+
+	private:
+		uintptr_t base;
+		std::vector<Range> ranges;
+	};
+
 	class SectionMap {
 	public:
+		SectionMap(uintptr_t base = 0) : base(base), executableRanges(base) {}
+
+		/// <summary>
+		/// Retrieves the ranges of every executable section (IMAGE_SCN_MEM_EXECUTE), whatever its name.
+		/// Protected images may keep code in sections besides .text.
+		/// </summary>
+		const SectionRanges& getExecutableRanges() const noexcept { return this->executableRanges; }
+
+		// internal function, refer to PEParser::getSectionRangesWithName
+		const SectionRanges* getSectionRangesWithName(std::string name)
+		{
+			auto iter = this->rangeMap.find(name);
+
+			if (iter != this->rangeMap.end()) {
+				return &iter->second;
+			}
+			else {
+				return nullptr;
+			}
+		}
+
 		// internal function, refer to PEParser::getSectionsWithName
 		PESections* getSectionsWithName(std::string name)
 		{
@@ -179,6 +287,10 @@ public:
 		{
 			if (!section) return false;
 
+			// keep the flat range table in sync with the section list
+			this->rangeMap.try_emplace(section->name, this->base).first->second.addRange(static_cast<unsigned int>(section->start.as()), section->size);
+			if (section->characteristics & IMAGE_SCN_MEM_EXECUTE) this->executableRanges.addRange(static_cast<unsigned int>(section->start.as()), section->size);
+
 			auto iter = this->sectionMap.find(section->name);
 
 			if (iter != this->sectionMap.end()) {
@@ -195,9 +307,25 @@ public:
 		}
 
 	private:
+		uintptr_t base;
 		std::unordered_map<std::string, std::vector<std::unique_ptr<Section>>> sectionMap;
+		std::unordered_map<std::string, SectionRanges> rangeMap;
+		SectionRanges executableRanges;
+	};
+
+	// Header fields identifying a specific build of an executable image.
+	struct ImageInfo {
+		unsigned int timeDateStamp;
+		unsigned int checkSum;
+		unsigned int sizeOfImage;
 	};
 
+	/// <summary>
+	/// Static. Retrieves the identifying header fields of the last parsed image.
+	/// </summary>
+	/// <returns>the ImageInfo struct, zeroed if PEParser::parse had not been called or failed</returns>
+	static ImageInfo getImageInfo() { return PEParser::imageInfo; }
+
 	/// <summary>
 	/// Creates a new instance of PEParser, filling in the PEParser::ProcessInfo struct,
 	/// unless one is already passed as the argument.
@@ -220,18 +348,38 @@ public:
 	{
 		// the ProcessInfo struct is necessary to get the base address of the executable
 		PEParser::setProcessInfo(pInfo);
+		PEParser::imageInfo = {};
 
-		unsigned char* base = reinterpret_cast<unsigned char*>(PEParser::pInfo->mInfo->lpBaseOfDll);
-		if (!base || *reinterpret_cast<short*>(base) != 0x5A4D) return false; // executable image magic number
+		PEParser::sectionMap = PEParser::parseImage(PEParser::pInfo->mInfo->lpBaseOfDll, &PEParser::imageInfo);
+		return !!PEParser::sectionMap;
+	}
+
+	/// <summary>
+	/// Static. Parses the PE headers of any image loaded at a given base address into a new SectionMap.
+	/// Does not touch the state used by PEParser::parse, images of different modules can be parsed concurrently.
+	/// </summary>
+	/// <param name="imageBase">: the base address of the loaded image</param>
+	/// <param name="pImageInfo">: (optional) receives the identifying header fields of the image</param>
+	/// <returns>a new SectionMap on success, nullptr if the PE headers do not match those of an executable image</returns>
+	static std::shared_ptr<SectionMap> parseImage(void* imageBase, ImageInfo* pImageInfo = nullptr)
+	{
+		unsigned char* base = reinterpret_cast<unsigned char*>(imageBase);
+		if (!base || *reinterpret_cast<short*>(base) != 0x5A4D) return nullptr; // executable image magic number
 
 		base += *reinterpret_cast<int*>(base + 0x3C);
-		if (*reinterpret_cast<int*>(base) != 0x4550) return false; // PE header magic number
+		if (*reinterpret_cast<int*>(base) != 0x4550) return nullptr; // PE header magic number
 
 		const short sectionCount = *reinterpret_cast<short*>(base + 0x06);
 
+		if (pImageInfo) {
+			pImageInfo->timeDateStamp = *reinterpret_cast<unsigned int*>(base + 0x08); // COFF header timestamp
+			pImageInfo->sizeOfImage = *reinterpret_cast<unsigned int*>(base + 0x18 + 0x38); // optional header image size
+			pImageInfo->checkSum = *reinterpret_cast<unsigned int*>(base + 0x18 + 0x40); // optional header checksum
+		}
+
 		base += *reinterpret_cast<short*>(base + 0x14) + 0x18; // add COFF and optional header sizes
 
-		PEParser::sectionMap = std::make_shared<SectionMap>();
+		auto sectionMap = std::make_shared<SectionMap>(reinterpret_cast<uintptr_t>(imageBase));
 
 		for (int i = 0; i < sectionCount; i++) {
 			auto section = new Section;
@@ -240,15 +388,145 @@ public:
 			section->size = *reinterpret_cast<int*>(base + 0x08); // virtual size of section
 			section->start = *reinterpret_cast<int*>(base + 0x0C); // virtual address of section
 			section->end = section->start.as() + section->size;
+			section->characteristics = *reinterpret_cast<unsigned int*>(base + 0x24);
 
-			PEParser::sectionMap->addSection(section);
+			sectionMap->addSection(section);
 
 			base += 0x28; // size of a section header
 		}
 
-		return true;
+		return sectionMap;
 	}
 
+	/// <summary>
+	/// An executable image file mapped into the current process with the layout of a loaded image, without loading it:
+	/// no imports are resolved and no code is run. The file can be any x86-64 build, e.g. one of several builds compared offline.
+	/// Absolute addresses are relocated to the address of the mapping, ibo32 values and RVAs are the same as in the loaded image.
+	/// The mapping is released when the instance is destroyed, anything scanned from it must not be used afterwards.
+	/// </summary>
+	class MappedImage {
+	public:
+		MappedImage(const MappedImage&) = delete;
+		MappedImage& operator=(const MappedImage&) = delete;
+
+		~MappedImage() { if (this->base) UnmapViewOfFile(this->base); }
+
+		/// <summary>
+		/// Static. Maps an image file as an image section (SEC_IMAGE), at its preferred base address if it is free,
+		/// otherwise anywhere with a private copy of every page holding a relocated address.
+		/// </summary>
+		/// <param name="path">: path to an .exe or .dll file</param>
+		/// <returns>the mapped image on success, nullptr if the file could not be mapped as an image or relocated</returns>
+		static std::unique_ptr<MappedImage> open(const std::string& path)
+		{
+			HANDLE hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (hFile == INVALID_HANDLE_VALUE) return nullptr;
+
+			HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY | SEC_IMAGE, 0, 0, nullptr);
+			CloseHandle(hFile);
+			if (!hMapping) return nullptr;
+
+			std::unique_ptr<MappedImage> image(new MappedImage());
+			image->path = path;
+
+			// a copy-on-write view lets the relocated pages be written without touching the file
+			image->base = reinterpret_cast<unsigned char*>(MapViewOfFileEx(hMapping, FILE_MAP_COPY, 0, 0, 0, MappedImage::getPreferredBase(hMapping)));
+			if (!image->base) image->base = reinterpret_cast<unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0));
+			CloseHandle(hMapping);
+			if (!image->base) return nullptr;
+
+			image->sections = PEParser::parseImage(image->base, &image->imageInfo);
+			if (!image->sections || !image->relocate()) return nullptr;
+
+			return image;
+		}
+
+		void* getBase() const noexcept { return this->base; }
+		size_t getSize() const noexcept { return this->imageInfo.sizeOfImage; }
+		const std::string& getPath() const noexcept { return this->path; }
+		const ImageInfo& getImageInfo() const noexcept { return this->imageInfo; }
+
+		/// <summary>
+		/// Retrieves the section map of the image, e.g. for RTTIScanner::scanImage, which scans images concurrently.
+		/// </summary>
+		std::shared_ptr<SectionMap> getSections() const noexcept { return this->sections; }
+
+		/// <summary>
+		/// Creates process information describing the image, for PEParser::parse and RTTIScanner::scan, which take ownership of it.
+		/// The scanner's default cache path is then the image file's path with ".rtticache" appended, as for the running executable.
+		/// </summary>
+		/// <returns>a new PEParser::ProcessInfo struct</returns>
+		ProcessInfo* createProcessInfo() const
+		{
+			ProcessInfo* pInfo = new ProcessInfo{ GetCurrentProcess(), nullptr, std::make_unique<MODULEINFO>(), this->path };
+			pInfo->mInfo->lpBaseOfDll = this->base;
+			pInfo->mInfo->SizeOfImage = this->imageInfo.sizeOfImage;
+			pInfo->mInfo->EntryPoint = nullptr;
+			return pInfo;
+		}
+
+	private:
+		MappedImage() = default;
+
+		// Reads the preferred base address from the headers, which are the first page of the image view.
+		static void* getPreferredBase(HANDLE hMapping)
+		{
+			unsigned char* headers = reinterpret_cast<unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0x1000));
+			if (!headers) return nullptr;
+
+			void* preferredBase = nullptr;
+			const unsigned char* nt = headers + *reinterpret_cast<int*>(headers + 0x3C);
+			if (*reinterpret_cast<const short*>(nt + 0x18) == 0x20B) preferredBase = *reinterpret_cast<void* const*>(nt + 0x18 + 0x18); // PE32+ optional header image base
+
+			UnmapViewOfFile(headers);
+			return preferredBase;
+		}
+
+		// Applies the base relocations of the image if it is not mapped at the address its headers were linked for.
+		bool relocate()
+		{
+			unsigned char* nt = this->base + *reinterpret_cast<int*>(this->base + 0x3C);
+			unsigned char* optionalHeader = nt + 0x18;
+			if (*reinterpret_cast<short*>(optionalHeader) != 0x20B) return false; // x86-64 images only
+
+			const uintptr_t delta = reinterpret_cast<uintptr_t>(this->base) - *reinterpret_cast<uintptr_t*>(optionalHeader + 0x18);
+			if (!delta) return true;
+
+			// data directory 5 is the base relocation table
+			if (*reinterpret_cast<unsigned int*>(optionalHeader + 0x6C) <= 5) return false;
+			const unsigned int relocationsStart = *reinterpret_cast<unsigned int*>(optionalHeader + 0x70 + 5 * 8);
+			const unsigned int relocationsSize = *reinterpret_cast<unsigned int*>(optionalHeader + 0x70 + 5 * 8 + 4);
+			if (!relocationsStart || static_cast<size_t>(relocationsStart) + relocationsSize > this->imageInfo.sizeOfImage) return false;
+
+			DWORD oldProtect;
+			if (!VirtualProtect(this->base, this->imageInfo.sizeOfImage, PAGE_WRITECOPY, &oldProtect)) return false;
+
+			for (unsigned int offset = 0; offset + 8 <= relocationsSize;) {
+				// a block of 16 bit entries covering one page
+				const unsigned char* block = this->base + relocationsStart + offset;
+				const unsigned int pageStart = *reinterpret_cast<const unsigned int*>(block);
+				const unsigned int blockSize = *reinterpret_cast<const unsigned int*>(block + 4);
+				if (blockSize < 8 || offset + blockSize > relocationsSize) break;
+
+				for (const unsigned short* entry = reinterpret_cast<const unsigned short*>(block + 8); entry < reinterpret_cast<const unsigned short*>(block + blockSize); ++entry) {
+					const size_t target = static_cast<size_t>(pageStart) + (*entry & 0xFFF);
+					// IMAGE_REL_BASED_DIR64, the only kind of relocation besides padding in x86-64 images
+					if (*entry >> 12 == 10 && target + sizeof(uintptr_t) <= this->imageInfo.sizeOfImage) *reinterpret_cast<uintptr_t*>(this->base + target) += delta;
+				}
+				offset += blockSize;
+			}
+
+			// nothing in the mapping is ever run
+			VirtualProtect(this->base, this->imageInfo.sizeOfImage, PAGE_READONLY, &oldProtect);
+			return true;
+		}
+
+		unsigned char* base = nullptr;
+		std::string path;
+		ImageInfo imageInfo{};
+		std::shared_ptr<SectionMap> sections;
+	};
+
 	/// <summary>
 	/// Retrieve a pointer to a vector of pointers to Section structures with a matching name. A single executable image can have multiple sections with identical names.
 	/// </summary>
@@ -261,6 +539,30 @@ public:
 		return PEParser::sectionMap->getSectionsWithName(name);
 	}
 
+	/// <summary>
+	/// Retrieve a pointer to the flat range table of all sections with a matching name.
+	/// Preferred over PEParser::getSectionsWithName for repeated membership tests.
+	/// </summary>
+	/// <param name="name">: sections to match</param>
+	/// <returns>a pointer to a SectionRanges table; if PEParser::parse had not been called or the section is missing, nullptr</returns>
+	const SectionRanges* getSectionRangesWithName(std::string name)
+	{
+		if (!PEParser::sectionMap) return nullptr;
+
+		return PEParser::sectionMap->getSectionRangesWithName(name);
+	}
+
+	/// <summary>
+	/// Retrieve a pointer to the flat range table of all executable sections, see PEParser::SectionMap::getExecutableRanges.
+	/// </summary>
+	/// <returns>a pointer to a SectionRanges table; if PEParser::parse had not been called, nullptr</returns>
+	const SectionRanges* getExecutableRanges()
+	{
+		if (!PEParser::sectionMap) return nullptr;
+
+		return &PEParser::sectionMap->getExecutableRanges();
+	}
+
 	/// <summary>
 	/// Static. Checks if a given address is inside any of the given sections.  
 	/// </summary>
@@ -320,4 +622,5 @@ public:
 private:
 	static inline std::shared_ptr<ProcessInfo> pInfo{};
 	static inline std::shared_ptr<SectionMap> sectionMap{};
+	static inline ImageInfo imageInfo{};
 };
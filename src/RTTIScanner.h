@@ -1,17 +1,36 @@
 #pragma once
 
 #include "PE.h"
+#include <intrin.h>
 #include <immintrin.h>
 
 #include <iostream>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <string_view>
+#include <typeinfo>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include <charconv>
 
 class RTTIScanner {
 public:
 	struct SectionData {
-		SectionData(PEParser::PESections* text, PEParser::PESections* data, PEParser::PESections* rdata) : text(text), data(data), rdata(rdata) {}
+		SectionData(PEParser::PESections* text, PEParser::PESections* data, PEParser::PESections* rdata,
+			const PEParser::SectionRanges* textRanges, const PEParser::SectionRanges* dataRanges, const PEParser::SectionRanges* rdataRanges) :
+			text(text), data(data), rdata(rdata), textRanges(textRanges), dataRanges(dataRanges), rdataRanges(rdataRanges) {}
 		PEParser::PESections* text;
 		PEParser::PESections* data;
 		PEParser::PESections* rdata;
+
+		// flat range tables used for membership tests in the scan loop
+		const PEParser::SectionRanges* textRanges;
+		const PEParser::SectionRanges* dataRanges;
+		const PEParser::SectionRanges* rdataRanges;
 	};
 
 #pragma pack(push, 1) // pack the struct to preserve instruction layout
@@ -67,25 +86,59 @@ public:
 			pCompleteObjectLocator(pCOL),
 			pTypeDescriptor(pTD),
 			pClassHierarchyDescriptor(pCHD),
-			pBaseClassDescriptor(pBCD) {}
+			pBaseClassDescriptor(pBCD),
+			classId(~0u),
+			functionCount(0) {}
 
 		~RTTI() {}
 
 		/// <summary>
 		/// Get the demangled class name from its type descriptor.
+		/// The name is demangled on the first call and cached afterwards.
 		/// </summary>
 		/// <returns>the demangled name on success, otherwise empty string</returns>
 		std::string getName()
 		{
-			return demangleName(this->pTypeDescriptor->name);
+			std::lock_guard<std::mutex> lock(RTTI::demangleMutex);
+
+			if (!this->nameDemangled) {
+				this->name = demangleName(this->pTypeDescriptor->name, false);
+				this->nameDemangled = true;
+			}
+
+			return this->name;
+		}
+
+		/// <summary>
+		/// Get the mangled class name from its type descriptor, as it is stored in memory (for example ".?AVPlayerIns@CS@@").
+		/// </summary>
+		/// <returns>a view of the mangled name inside the type descriptor</returns>
+		std::string_view getMangledName() const noexcept
+		{
+			return this->pTypeDescriptor->name;
 		}
 
 		/// <summary>
 		/// Demangle a mangled C++ symbol name.
+		/// DbgHelp functions are single threaded, calls are serialized internally.
 		/// </summary>
 		/// <param name="name">: pointer to a null terminated char string</param>
 		/// <returns>the demangled name on success, otherwise empty string</returns>
 		static std::string demangleName(const char* name)
+		{
+			return demangleName(name, true);
+		}
+
+		void** pVirtualFunctionTable;
+		RTTIScanner::CompleteObjectLocator* pCompleteObjectLocator;
+		RTTIScanner::TypeDescriptor* pTypeDescriptor;
+		RTTIScanner::ClassHierarchyDescriptor* pClassHierarchyDescriptor;
+		RTTIScanner::BaseClassDescriptor* pBaseClassDescriptor;
+		unsigned int classId; // the position of the record in its class map, see RTTIScanner::ClassIndex::getClass
+		unsigned int functionCount; // the amount of virtual functions of the primary table, 0 until the class map's reverse index is built
+
+	private:
+		static std::string demangleName(const char* name, bool lock)
 		{
 			char output[256];
 
@@ -94,6 +147,9 @@ public:
 				name++;
 			}
 
+			std::unique_lock<std::mutex> guard(RTTI::demangleMutex, std::defer_lock);
+			if (lock) guard.lock();
+
 			// UnDecorateSymbolName returns the total length of the demangled string on success, 0 on failure
 			if (!UnDecorateSymbolName(name, output, sizeof(output), UNDNAME_NO_ARGUMENTS | UNDNAME_NAME_ONLY | UNDNAME_32_BIT_DECODE | UNDNAME_NO_MS_KEYWORDS | UNDNAME_NO_LEADING_UNDERSCORES)) {
 				return "";
@@ -103,99 +159,2798 @@ public:
 			}
 		}
 
-		void** pVirtualFunctionTable;
-		RTTIScanner::CompleteObjectLocator* pCompleteObjectLocator;
-		RTTIScanner::TypeDescriptor* pTypeDescriptor;
-		RTTIScanner::ClassHierarchyDescriptor* pClassHierarchyDescriptor;
-		RTTIScanner::BaseClassDescriptor* pBaseClassDescriptor;
+		std::string name;
+		bool nameDemangled = false;
+
+		static inline std::mutex demangleMutex{};
 	};
 
-	RTTIScanner() { RTTIScanner::parser.reset(new PEParser()); }
-	~RTTIScanner() { RTTIScanner::parser.reset(); RTTIScanner::classRTTI.clear(); RTTIScanner::sectionData.reset(); }
+	/// <summary>
+	/// A base class of a class, as described by a BaseClassDescriptor of its base class array.
+	/// </summary>
+	struct BaseClass {
+		static constexpr unsigned int noClass = ~0u;
+
+		unsigned int classId; // the class id of the base, BaseClass::noClass if it has no virtual function table of its own
+		TypeDescriptor* pTypeDescriptor;
+		unsigned int numContainedBases; // the amount of bases of the base, which directly follow it in the base class array
+		int mdisp; // offset of the base inside of the class
+		int pdisp; // offset of the virtual base table pointer, -1 if the base is not virtual
+		int vdisp; // offset of the base's displacement inside of the virtual base table
+		unsigned int attributes;
+	};
 
 	/// <summary>
-	/// Scans the executable's text section(s) to retrieve class RTTI by matching instruction patterns inside class object constructors.
-	/// Pointers to RTTI structs are mapped on a RTTIScanner::classRTTI map, using class names as keys.
+	/// A contiguous range of class records of a class map, e.g. the classes matching a name prefix.
+	/// Valid as long as the class map, iterating it yields RTTI pointers.
 	/// </summary>
-	/// <param name="pInfo">: (optional) a pointer to a PEParser::ProcessInfo struct overriding the default process information used by the parser</param>
-	/// <returns>true on success, false on initialization failure</returns>
-	bool scan(PEParser::ProcessInfo* pInfo = nullptr)
-	{
-		// parse the PE headers and get section addresses and process information
-		if (!RTTIScanner::parser->parse(pInfo) || !this->setSectionData()) return false;
+	struct ClassSpan {
+		RTTI* const* first;
+		RTTI* const* last;
 
-		auto processInfo = this->parser->getProcessInfo();
-		if (!processInfo) return false;
+		RTTI* const* begin() const noexcept { return this->first; }
+		RTTI* const* end() const noexcept { return this->last; }
+		size_t size() const noexcept { return this->last - this->first; }
+		bool empty() const noexcept { return this->first == this->last; }
+		RTTI* operator[](size_t index) const noexcept { return this->first[index]; }
+	};
 
-		//get executable base address and sections
-		unsigned char* base = reinterpret_cast<unsigned char*>(processInfo->mInfo->lpBaseOfDll);
+	/// <summary>
+	/// The class map of a single image: RTTI records indexed by mangled class name, with a secondary index by demangled name built on demand.
+	/// Records are stored in blocks which are reserved up front and never reallocated, keeping pointers to records stable.
+	/// An index must be filled from a single thread before it is shared, lookups are thread safe and lock free once it is filled
+	/// (except for the one lookup that builds the demangled index).
+	/// </summary>
+	class ClassIndex {
+	public:
+		ClassIndex() : recordCount(0), demangledIndexBuilt(false), sortedIndexBuilt(false), fingerprintsBuilt(false), imageBase(nullptr), generation(ClassIndex::nextGeneration++) {}
 
-		PEParser::PESections* text = this->sectionData->text;
-		PEParser::PESections* data = this->sectionData->data;
-		PEParser::PESections* rdata = this->sectionData->rdata;
+		ClassIndex(const ClassIndex&) = delete;
+		ClassIndex& operator=(const ClassIndex&) = delete;
 
-		if (!text || !data || !rdata) return false;
+		/// <summary>
+		/// Calls a function for every indexed class, in the order they were inserted.
+		/// </summary>
+		/// <param name="function">: a function taking an RTTIScanner::RTTI reference</param>
+		template <typename F> void forEach(F&& function)
+		{
+			for (auto& block : this->rttiArena) {
+				for (RTTI& rtti : block) function(rtti);
+			}
+		}
+
+		/// <summary>
+		/// Retrieves a number identifying the contents of the index, unique among all indices of the process and changed when the index is cleared.
+		/// </summary>
+		unsigned long long getGeneration() const noexcept { return this->generation; }
+
+		/// <summary>
+		/// Retrieves the base address of the image the indexed classes belong to, nullptr if the hierarchy has not been built.
+		/// </summary>
+		void* getImageBase() const noexcept { return this->imageBase; }
+
+		/// <summary>
+		/// Retrieves the amount of indexed classes.
+		/// </summary>
+		/// <returns>the amount of classes with RTTI</returns>
+		size_t size() const noexcept { return this->recordCount; }
+
+		/// <summary>
+		/// Retrieves a pointer to the RTTI of a class by its mangled or demangled name, see RTTIScanner::getClassRTTI.
+		/// </summary>
+		/// <param name="name">: name of the class to get RTTI of</param>
+		/// <returns>a pointer to class RTTI on success, otherwise nullptr</returns>
+		RTTI* find(std::string_view name)
+		{
+			if (!name.compare(0, 3, ".?A")) return this->findMangled(name);
+
+			char mangled[sizeof(TypeDescriptor::name)];
+			if (size_t length = RTTIScanner::mangleName(name, mangled, sizeof(mangled))) {
+				// try both the class and the struct type prefix
+				if (RTTI* pRTTI = this->findMangled(std::string_view(mangled, length))) return pRTTI;
+				mangled[3] = 'U';
+				if (RTTI* pRTTI = this->findMangled(std::string_view(mangled, length))) return pRTTI;
+			}
+
+			if (!this->demangledIndexBuilt.load(std::memory_order_acquire)) {
+				std::lock_guard<std::mutex> lock(this->demangledMutex);
+				if (!this->demangledIndexBuilt.load(std::memory_order_relaxed)) this->buildDemangledIndex();
+			}
+
+			IndexEntry* entry = this->demangledNames.find(name, RTTIScanner::hashName(name));
+			return entry ? entry->pRTTI : nullptr;
+		}
 
-		for (auto& section : *rdata) {
-			auto pCOL = section->start.as<CompleteObjectLocator**>(base);
-			auto end = section->end.as<CompleteObjectLocator**>(base);
-			while (pCOL++ < end) {
-				auto COL = *pCOL;
-				if (!PEParser::isAddressInSection(COL, rdata)) continue;
-				if (!PEParser::isAddressInSection(*(++pCOL), text)) continue;
-				if (COL->signature != 1) continue;
-				if (!PEParser::isIbo32InSection(COL->iboTypeDescriptor, data)) continue;
-				if (!PEParser::isIbo32InSection(COL->iboClassDescriptor, rdata)) continue;
-				TypeDescriptor* TD = COL->iboTypeDescriptor.as<TypeDescriptor*>(base);
-				ClassHierarchyDescriptor* CHD = COL->iboClassDescriptor.as<ClassHierarchyDescriptor*>(base);
+		RTTI* findMangled(std::string_view name)
+		{
+			IndexEntry* entry = this->mangledNames.find(name, RTTIScanner::hashName(name));
+			return entry ? entry->pRTTI : nullptr;
+		}
 
-				if (!PEParser::isIbo32InSection(CHD->iboBaseClassDescriptor, rdata)) continue;
-				BaseClassDescriptor* pBCD = CHD->iboBaseClassDescriptor.as< BaseClassDescriptor*>(base);
+		/// <summary>
+		/// Retrieves every class whose demangled name starts with a prefix ("CS::ChrIns" finds "CS::ChrIns" and "CS::ChrInsModule"),
+		/// by binary search over the sorted name index. The index is built on the first query, which locks,
+		/// and is lock free afterwards. Plain names are demangled from the mangled names directly, others through DbgHelp.
+		/// </summary>
+		/// <param name="prefix">: the start of the demangled names, empty for all classes</param>
+		/// <returns>the matching classes sorted by demangled name, empty if there are none</returns>
+		ClassSpan findByPrefix(std::string_view prefix)
+		{
+			this->requireSortedIndex();
 
-				// demangleName will return an empty string if the class name is invalid
-				std::string name = RTTI::demangleName(TD->name);
-				if (name.empty()) continue;
+			const unsigned int count = static_cast<unsigned int>(this->sortedClasses.size());
+			auto nameAt = [this](unsigned int i) { return this->getSortedName(i); };
 
-				RTTIScanner::classRTTI.emplace(name, std::make_unique<RTTI>(reinterpret_cast<void**>(pCOL), COL, TD, CHD, pBCD));
+			// the names starting with the prefix are a contiguous run of the sorted names
+			unsigned int low = 0, high = count;
+			while (low < high) {
+				unsigned int middle = low + (high - low) / 2;
+				if (nameAt(middle) < prefix) low = middle + 1;
+				else high = middle;
 			}
+			unsigned int first = low;
+			high = count;
+			while (low < high) {
+				unsigned int middle = low + (high - low) / 2;
+				if (!nameAt(middle).compare(0, prefix.size(), prefix)) low = middle + 1;
+				else high = middle;
+			}
+
+			RTTI* const* classes = this->sortedClasses.data();
+			return { classes + first, classes + low };
 		}
 
-		return true;
-	}
+		/// <summary>
+		/// Retrieves every class whose demangled name matches a wildcard pattern, '*' matching any run of characters and '?' any single one
+		/// ("CS::*Ins", "*::Chr??s*"). The literal start of the pattern narrows the search to a range of the sorted name index,
+		/// see RTTIScanner::ClassIndex::findByPrefix, the rest is matched against the contiguous name buffer with a SIMD character search.
+		/// </summary>
+		/// <param name="pattern">: the wildcard pattern, matched against whole names</param>
+		/// <param name="results">: receives pointers to the matching classes sorted by demangled name, appended to the vector</param>
+		/// <returns>the amount of matching classes</returns>
+		size_t findMatching(std::string_view pattern, std::vector<RTTI*>& results)
+		{
+			const size_t literal = (std::min)(pattern.find('*'), pattern.find('?'));
+			ClassSpan range = this->findByPrefix(pattern.substr(0, literal));
+			const unsigned int first = static_cast<unsigned int>(range.first - this->sortedClasses.data());
+			const unsigned int last = static_cast<unsigned int>(range.last - this->sortedClasses.data());
 
-	/// <summary>
-	/// Retrieves a pointer to the RTTI of a class after a scan, by name.
-	/// </summary>
-	/// <param name="name">: name of the class to get RTTI of</param>
-	/// <returns>a pointer to class RTTI on success, otherwise nullptr</returns>
-	static RTTI* getClassRTTI(std::string name)
-	{ 
-		auto iter = RTTIScanner::classRTTI.find(name); 
-		return iter != RTTIScanner::classRTTI.end() ? RTTIScanner::classRTTI[name].get() : nullptr; 
-	}
+			size_t count = 0;
+			for (unsigned int i = first; i < last; ++i) {
+				std::string_view name = this->getSortedName(i);
 
-private:
-	static inline std::unique_ptr<PEParser> parser{};
-	static inline std::unordered_map<std::string, std::unique_ptr<RTTI>> classRTTI{};
-	static inline std::unique_ptr<SectionData> sectionData{};
+				// without wildcards only exact names match, they sort first in the range
+				if (literal == std::string_view::npos && name.size() != pattern.size()) break;
+				if (literal != std::string_view::npos && !ClassIndex::matchPattern(name, pattern, literal)) continue;
 
-	// REX.W lea reg1,[rip]
-	// REX.W mov [reg2],reg1
-	const __m128i signature = _mm_setr_epi8(0x48, 0x8D, 0x05, 0x0, 0x0, 0x0, 0x0, 0x48, 0x89, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0);
-	const __m128i bitmask = _mm_setr_epi8(0b00000100, 0, 0b00111000, -1, -1, -1, -1, 0b00000101, 0, 0b00111111, -1, -1, -1, -1, -1, -1);
+				results.push_back(this->sortedClasses[i]);
+				++count;
+			}
+			return count;
+		}
 
-	bool setSectionData()
-	{
-		RTTIScanner::sectionData.reset();
+		/// <summary>
+		/// Makes room for a number of records, so that inserting them allocates at most once.
+		/// </summary>
+		/// <param name="count">: the amount of records about to be inserted</param>
+		void reserve(size_t count)
+		{
+			if (!count) return;
 
-		PEParser::PESections* text = RTTIScanner::parser->getSectionsWithName(".text");
-		PEParser::PESections* data = RTTIScanner::parser->getSectionsWithName(".data");
-		PEParser::PESections* rdata = RTTIScanner::parser->getSectionsWithName(".rdata");
+			if (this->rttiArena.empty() || this->rttiArena.back().capacity() - this->rttiArena.back().size() < count) {
+				this->rttiArena.emplace_back().reserve(count > 256 ? count : 256);
+			}
 
-		if (!text || !data || !rdata) return false;
+			this->mangledNames.reserve(this->recordCount + count);
+		}
+
+		/// <summary>
+		/// Stores a record and indexes it by its mangled name, unless a record with the same name exists.
+		/// </summary>
+		/// <returns>a pointer to the stored record, nullptr if the name was already indexed</returns>
+		RTTI* insert(std::string_view name, RTTI&& record)
+		{
+			this->reserve(1);
 
-		RTTIScanner::sectionData.reset(new SectionData(text, data, rdata));
+			unsigned int hash = RTTIScanner::hashName(name);
+			IndexEntry* entry = this->mangledNames.find(name, hash);
+			if (entry->pRTTI) return nullptr;
 
-		return true;
-	}
+			RTTI* pRTTI = &this->rttiArena.back().emplace_back(std::move(record));
+			pRTTI->classId = static_cast<unsigned int>(this->recordCount);
+			this->mangledNames.insert(entry, name, hash, pRTTI);
+			++this->recordCount;
+
+			return pRTTI;
+		}
+
+		/// <summary>
+		/// Retrieves a class by its id, the position of its record in insertion order (RTTI::classId).
+		/// </summary>
+		/// <returns>a pointer to class RTTI on success, nullptr if the id is out of range or the hierarchy has not been built</returns>
+		RTTI* getClass(unsigned int classId) const noexcept
+		{
+			return classId < this->classById.size() ? this->classById[classId] : nullptr;
+		}
+
+		/// <summary>
+		/// Builds the class hierarchy index from the ClassHierarchyDescriptor and BaseClassDescriptor arrays of every indexed class:
+		/// the base classes of each class with their displacements, the derived classes of each class and a table of (derived, base) pairs.
+		/// Must be called once after all records are inserted and before the index is shared with other threads.
+		/// </summary>
+		/// <param name="base">: image base address</param>
+		/// <param name="dataRanges">: .data ranges of the image, type descriptors must lie inside them</param>
+		/// <param name="rdataRanges">: .rdata ranges of the image, base class arrays and descriptors must lie inside them</param>
+		void buildHierarchy(unsigned char* base, const PEParser::SectionRanges& dataRanges, const PEParser::SectionRanges& rdataRanges)
+		{
+			const unsigned int classCount = static_cast<unsigned int>(this->recordCount);
+
+			this->classById.clear();
+			this->classById.reserve(classCount);
+			this->imageBase = base;
+
+			// type descriptors are unique per image, the table is kept at most half full
+			size_t typeTableSize = 16;
+			while (typeTableSize < static_cast<size_t>(classCount) * 2) typeTableSize *= 2;
+			this->typeTable.assign(typeTableSize, TypeEntry{});
+
+			this->forEach([this](RTTI& rtti) {
+				const size_t mask = this->typeTable.size() - 1;
+				size_t i = ClassIndex::hashPair(reinterpret_cast<uintptr_t>(rtti.pTypeDescriptor)) & mask;
+				while (this->typeTable[i].pTypeDescriptor) i = (i + 1) & mask;
+				this->typeTable[i] = { rtti.pTypeDescriptor, rtti.classId };
+
+				this->classById.push_back(&rtti);
+			});
+
+			// the base class array of a class lists itself first, followed by all of its direct and indirect bases
+			this->baseOffsets.assign(1, 0);
+			this->baseOffsets.reserve(classCount + 1);
+			this->baseClasses.clear();
+			std::vector<unsigned int> derivedCounts(classCount, 0);
+			for (RTTI* pRTTI : this->classById) {
+				ClassHierarchyDescriptor* CHD = pRTTI->pClassHierarchyDescriptor;
+				auto baseClassArray = CHD->iboBaseClassDescriptor.as<PEParser::ibo32*>(base);
+
+				// bases may be defined in other modules, so the count is only bounded by the section holding the array
+				unsigned int numBaseClasses = CHD->numBaseClasses;
+				if (rdataRanges.getRemaining(baseClassArray) / sizeof(PEParser::ibo32) < numBaseClasses) numBaseClasses = 0;
+
+				for (unsigned int i = 1; i < numBaseClasses; ++i) {
+					if (!rdataRanges.contains(baseClassArray[i])) continue;
+					BaseClassDescriptor* BCD = baseClassArray[i].as<BaseClassDescriptor*>(base);
+					if (!rdataRanges.contains(BCD) || !dataRanges.contains(PEParser::ibo32(BCD->offsetTypeDescriptor))) continue;
+
+					auto TD = PEParser::ibo32(BCD->offsetTypeDescriptor).as<TypeDescriptor*>(base);
+					RTTI* pBase = this->findByTypeDescriptor(TD);
+					unsigned int baseId = pBase ? pBase->classId : BaseClass::noClass;
+
+					this->baseClasses.push_back({ baseId, TD, BCD->numExtendedClasses, BCD->displacements[0], BCD->displacements[1], BCD->displacements[2], BCD->flags });
+					if (baseId != BaseClass::noClass) ++derivedCounts[baseId];
+				}
+
+				this->baseOffsets.push_back(static_cast<unsigned int>(this->baseClasses.size()));
+			}
+
+			// invert the base lists into flat derived lists, in class id order
+			this->derivedOffsets.assign(classCount + 1, 0);
+			for (unsigned int i = 0; i < classCount; ++i) this->derivedOffsets[i + 1] = this->derivedOffsets[i] + derivedCounts[i];
+			this->derivedClasses.assign(this->derivedOffsets[classCount], 0);
+
+			std::vector<unsigned int> fill(this->derivedOffsets.begin(), this->derivedOffsets.end() - 1);
+			size_t pairCount = 0;
+			for (unsigned int id = 0; id < classCount; ++id) {
+				for (unsigned int i = this->baseOffsets[id]; i < this->baseOffsets[id + 1]; ++i) {
+					unsigned int baseId = this->baseClasses[i].classId;
+					if (baseId == BaseClass::noClass) continue;
+
+					// a base repeated in a class without virtual inheritance is listed once per path, its derived list only needs the class once
+					if (this->derivedOffsets[baseId] == fill[baseId] || this->derivedClasses[fill[baseId] - 1] != id) {
+						this->derivedClasses[fill[baseId]++] = id;
+					}
+					++pairCount;
+				}
+			}
+
+			// the derived lists of bases repeated in a class have unused slots at their end, compact the lists
+			unsigned int compacted = 0;
+			for (unsigned int id = 0; id < classCount; ++id) {
+				unsigned int begin = this->derivedOffsets[id];
+				this->derivedOffsets[id] = compacted;
+				for (unsigned int i = begin; i < fill[id]; ++i) this->derivedClasses[compacted++] = this->derivedClasses[i];
+			}
+			this->derivedOffsets[classCount] = compacted;
+			this->derivedClasses.resize(compacted);
+
+			// (derived, base) pairs for constant time derivation checks, kept at most half full
+			size_t tableSize = 16;
+			while (tableSize < pairCount * 2) tableSize *= 2;
+			this->baseTable.assign(tableSize, BaseEntry{});
+
+			const size_t mask = tableSize - 1;
+			for (unsigned int id = 0; id < classCount; ++id) {
+				for (unsigned int i = this->baseOffsets[id]; i < this->baseOffsets[id + 1]; ++i) {
+					unsigned int baseId = this->baseClasses[i].classId;
+					if (baseId == BaseClass::noClass) continue;
+
+					unsigned long long key = ClassIndex::getPairKey(id, baseId);
+					size_t slot = ClassIndex::hashPair(key) & mask;
+					while (this->baseTable[slot].key && this->baseTable[slot].key != key) slot = (slot + 1) & mask;
+
+					BaseEntry& entry = this->baseTable[slot];
+					if (!entry.key) entry = { key, i, 0 };
+					++entry.count;
+				}
+			}
+		}
+
+		/// <summary>
+		/// Checks if a class is derived from another class, directly or indirectly. Constant time, does not read the image.
+		/// </summary>
+		/// <param name="derived">: a class of this index</param>
+		/// <param name="base">: a class of this index</param>
+		/// <returns>true if base is a base class of derived, otherwise false (also if both are the same class)</returns>
+		bool isDerivedFrom(const RTTI& derived, const RTTI& base) const noexcept
+		{
+			return this->findBaseEntry(derived, base);
+		}
+
+		/// <summary>
+		/// Retrieves the base class entry of derived describing base, see RTTIScanner::BaseClass.
+		/// </summary>
+		/// <param name="pCount">: (optional) receives how often base occurs in derived, more than once makes it an ambiguous base</param>
+		/// <returns>a pointer to the first entry of base among the base classes of derived, nullptr if base is not a base class of derived</returns>
+		const BaseClass* findBaseClass(const RTTI& derived, const RTTI& base, unsigned int* pCount = nullptr) const noexcept
+		{
+			const BaseEntry* entry = this->findBaseEntry(derived, base);
+			if (pCount) *pCount = entry ? entry->count : 0;
+			return entry ? &this->baseClasses[entry->baseIndex] : nullptr;
+		}
+
+		/// <summary>
+		/// Calls a function for every base class of a class, in the order of its base class array (depth first, left to right).
+		/// </summary>
+		/// <param name="derived">: a class of this index</param>
+		/// <param name="function">: a function taking a const RTTIScanner::BaseClass reference</param>
+		template <typename F> void forEachBaseClass(const RTTI& derived, F&& function) const
+		{
+			if (!this->owns(derived)) return;
+
+			for (unsigned int i = this->baseOffsets[derived.classId]; i < this->baseOffsets[derived.classId + 1]; ++i) function(this->baseClasses[i]);
+		}
+
+		/// <summary>
+		/// Calls a function for every class derived from a class, directly or indirectly, in class id order.
+		/// </summary>
+		/// <param name="base">: a class of this index</param>
+		/// <param name="function">: a function taking an RTTIScanner::RTTI reference</param>
+		template <typename F> void forEachDerived(const RTTI& base, F&& function) const
+		{
+			if (!this->owns(base)) return;
+
+			for (unsigned int i = this->derivedOffsets[base.classId]; i < this->derivedOffsets[base.classId + 1]; ++i) {
+				function(*this->classById[this->derivedClasses[i]]);
+			}
+		}
+
+		/// <summary>
+		/// Retrieves every class derived from a class, directly or indirectly.
+		/// </summary>
+		/// <param name="base">: a class of this index</param>
+		/// <returns>pointers to the RTTI of the derived classes, in class id order</returns>
+		std::vector<RTTI*> allDerived(const RTTI& base) const
+		{
+			std::vector<RTTI*> derived;
+			if (this->owns(base)) derived.reserve(this->derivedOffsets[base.classId + 1] - this->derivedOffsets[base.classId]);
+			this->forEachDerived(base, [&derived](RTTI& rtti) { derived.push_back(&rtti); });
+			return derived;
+		}
+
+		/// <summary>
+		/// Retrieves the class described by a type descriptor of the image. Constant time, does not read the image.
+		/// </summary>
+		/// <returns>a pointer to class RTTI on success, nullptr if the type has no virtual function table or the hierarchy has not been built</returns>
+		RTTI* findByTypeDescriptor(const TypeDescriptor* pTypeDescriptor) const noexcept
+		{
+			if (this->typeTable.empty()) return nullptr;
+
+			const size_t mask = this->typeTable.size() - 1;
+			for (size_t i = ClassIndex::hashPair(reinterpret_cast<uintptr_t>(pTypeDescriptor)) & mask;; i = (i + 1) & mask) {
+				const TypeEntry& entry = this->typeTable[i];
+				if (entry.pTypeDescriptor == pTypeDescriptor) return this->classById[entry.classId];
+				if (!entry.pTypeDescriptor) return nullptr;
+			}
+		}
+
+		/// <summary>
+		/// Builds the reverse index from virtual function table to class, for every table found by the scan: the primary table of each class
+		/// and the secondary tables of multiply inherited classes. Must be called after RTTIScanner::ClassIndex::buildHierarchy,
+		/// once and before the index is shared with other threads.
+		/// The functions of every table are counted once here: a table ends before the complete object locator slot of the next table,
+		/// at the first null pointer and at the first pointer into the image outside of its code. Pointers outside of the image
+		/// (hooks, functions of other modules) are counted if they point into committed executable memory.
+		/// </summary>
+		/// <param name="candidates">: the validated complete object locator slots of the image in address order, see RTTIScanner::findCandidates</param>
+		/// <param name="codeRanges">: the executable section ranges of the image, see RTTIScanner::getCodeRanges</param>
+		void buildVirtualFunctionTableIndex(const std::vector<CompleteObjectLocator**>& candidates, const PEParser::SectionRanges& codeRanges)
+		{
+			this->tableOffsets.clear();
+			this->tableEntries.clear();
+			this->slotFunctions.clear();
+			this->slotFingerprints.clear();
+			this->fingerprintsBuilt.store(false);
+			this->tableOffsets.reserve(candidates.size());
+			this->tableEntries.reserve(candidates.size());
+			this->codeRanges = codeRanges;
+
+			const unsigned char* nt = this->imageBase + *reinterpret_cast<const int*>(this->imageBase + 0x3C);
+			const size_t imageSize = *reinterpret_cast<const unsigned int*>(nt + 0x18 + 0x38); // optional header image size
+			MEMORY_BASIC_INFORMATION region{}; // the last region queried, tables mostly point into the same few regions
+
+			// the candidates are sorted by address, so the table offsets come out sorted for the binary search
+			for (size_t i = 0; i < candidates.size(); ++i) {
+				CompleteObjectLocator** pCOL = candidates[i];
+				PEParser::ibo32 iboTypeDescriptor = (*pCOL)->iboTypeDescriptor;
+				RTTI* pRTTI = this->findByTypeDescriptor(iboTypeDescriptor.as<TypeDescriptor*>(this->imageBase));
+				if (!pRTTI) continue;
+
+				void** pVirtualFunctionTable = reinterpret_cast<void**>(pCOL + 1);
+				const size_t tableOffset = reinterpret_cast<unsigned char*>(pVirtualFunctionTable) - this->imageBase;
+				const size_t capacity = i + 1 < candidates.size() ? reinterpret_cast<void**>(candidates[i + 1]) - pVirtualFunctionTable : (imageSize - tableOffset) / sizeof(void*);
+
+				const unsigned int firstSlot = static_cast<unsigned int>(this->slotFunctions.size());
+				for (size_t slot = 0; slot < capacity; ++slot) {
+					const uintptr_t offset = reinterpret_cast<uintptr_t>(pVirtualFunctionTable[slot]) - reinterpret_cast<uintptr_t>(this->imageBase);
+					if (offset < imageSize) {
+						if (!codeRanges.containsOffset(offset)) break;
+						this->slotFunctions.push_back(static_cast<unsigned int>(offset));
+					}
+					else {
+						if (!ClassIndex::isExecutable(pVirtualFunctionTable[slot], region)) break;
+						this->slotFunctions.push_back(0); // not a function of this image, it has no fingerprint
+					}
+				}
+				const unsigned int functionCount = static_cast<unsigned int>(this->slotFunctions.size()) - firstSlot;
+
+				this->tableOffsets.push_back(static_cast<unsigned int>(tableOffset));
+				this->tableEntries.push_back({ pRTTI->classId, (*pCOL)->offset, functionCount, firstSlot });
+				if (pRTTI->pVirtualFunctionTable == pVirtualFunctionTable) pRTTI->functionCount = functionCount;
+			}
+		}
+
+		/// <summary>
+		/// Retrieves the class owning a virtual function table, by binary search over the table offsets of the image. Does not read the image.
+		/// </summary>
+		/// <param name="pVirtualFunctionTable">: pointer to a virtual function table, e.g. the first pointer of an object</param>
+		/// <param name="pOffset">: (optional) receives the offset of the subobject using the table inside of the complete object, 0 for primary tables</param>
+		/// <returns>a pointer to the RTTI of the complete class, nullptr if the table is not one of this index</returns>
+		RTTI* findByVirtualFunctionTable(const void* pVirtualFunctionTable, unsigned int* pOffset = nullptr) const noexcept
+		{
+			const TableEntry* entry = this->findTable(pVirtualFunctionTable);
+			if (!entry) return nullptr;
+
+			if (pOffset) *pOffset = entry->offset;
+			return this->classById[entry->classId];
+		}
+
+		/// <summary>
+		/// Retrieves the amount of functions of a virtual function table, as counted by RTTIScanner::ClassIndex::buildVirtualFunctionTableIndex.
+		/// Does not read the image, an index is valid for hooking if it is below the count.
+		/// </summary>
+		/// <param name="pVirtualFunctionTable">: pointer to a virtual function table</param>
+		/// <returns>the amount of functions, 0 if the table is not one of this index</returns>
+		unsigned int getFunctionCount(const void* pVirtualFunctionTable) const noexcept
+		{
+			const TableEntry* entry = this->findTable(pVirtualFunctionTable);
+			return entry ? entry->functionCount : 0;
+		}
+
+		/// <summary>
+		/// Retrieves the fingerprints of the functions of a virtual function table: an FNV-1a hash of the first (up to) 16 bytes of code of every function,
+		/// as it was when the index was built. Functions outside of the image have a fingerprint of 0.
+		/// Fingerprints are computed for every table on the first call, which locks, and are returned without locking afterwards.
+		/// </summary>
+		/// <param name="pVirtualFunctionTable">: pointer to a virtual function table</param>
+		/// <param name="pCount">: (optional) receives the amount of fingerprints, see RTTIScanner::ClassIndex::getFunctionCount</param>
+		/// <returns>a pointer to the fingerprints in slot order, nullptr if the table is not one of this index</returns>
+		const unsigned int* getFingerprints(const void* pVirtualFunctionTable, unsigned int* pCount = nullptr) const
+		{
+			const TableEntry* entry = this->findTable(pVirtualFunctionTable);
+			if (pCount) *pCount = entry ? entry->functionCount : 0;
+			if (!entry) return nullptr;
+
+			if (!this->fingerprintsBuilt.load(std::memory_order_acquire)) {
+				std::lock_guard<std::mutex> lock(this->fingerprintMutex);
+				if (!this->fingerprintsBuilt.load(std::memory_order_relaxed)) this->buildFingerprints();
+			}
+
+			return this->slotFingerprints.data() + entry->firstSlot;
+		}
+
+		/// <summary>
+		/// Finds the slot of a virtual function table holding a function by its fingerprint, e.g. to find a function again after
+		/// an update of the image moved it to another slot.
+		/// </summary>
+		/// <param name="pVirtualFunctionTable">: pointer to a virtual function table</param>
+		/// <param name="fingerprint">: the fingerprint of the function, see RTTIScanner::ClassIndex::getFingerprint</param>
+		/// <returns>the index of the first slot with the fingerprint, ~0u if there is none or the table is not one of this index</returns>
+		unsigned int findSlot(const void* pVirtualFunctionTable, unsigned int fingerprint) const
+		{
+			unsigned int count = 0;
+			const unsigned int* fingerprints = this->getFingerprints(pVirtualFunctionTable, &count);
+			for (unsigned int i = 0; i < count && fingerprint; ++i) {
+				if (fingerprints[i] == fingerprint) return i;
+			}
+			return ~0u;
+		}
+
+		/// <summary>
+		/// Computes the fingerprint of a function of the image, see RTTIScanner::ClassIndex::getFingerprints.
+		/// </summary>
+		/// <param name="function">: pointer to the function</param>
+		/// <returns>the fingerprint, 0 if the function is not inside of the image's code</returns>
+		unsigned int getFingerprint(const void* function) const noexcept
+		{
+			return this->fingerprintOffset(reinterpret_cast<uintptr_t>(function) - reinterpret_cast<uintptr_t>(this->imageBase));
+		}
+
+		/// <summary>
+		/// Calls a function for every virtual function table of the reverse index, in address order. Does not read the image.
+		/// The function receives the table, the RTTI of its complete class, the offset of the subobject using the table
+		/// and the amount of functions of the table, see RTTIScanner::ClassIndex::getFunctionCount.
+		/// </summary>
+		/// <param name="function">: a function taking (void** pVirtualFunctionTable, RTTIScanner::RTTI&amp; rtti, unsigned int offset, unsigned int functionCount)</param>
+		template <typename F> void forEachVirtualFunctionTable(F&& function) const
+		{
+			for (size_t i = 0; i < this->tableOffsets.size(); ++i) {
+				const TableEntry& entry = this->tableEntries[i];
+				void** pVirtualFunctionTable = reinterpret_cast<void**>(this->imageBase + this->tableOffsets[i]);
+				function(pVirtualFunctionTable, *this->classById[entry.classId], entry.offset, entry.functionCount);
+			}
+		}
+
+		/// <summary>
+		/// Casts a polymorphic object of this index's image to a class, like dynamic_cast to a pointer: up, down and across the hierarchy.
+		/// The object's complete class is found through the complete object locator preceding its virtual function table
+		/// and the cast is resolved with the hierarchy index, the resulting offset is cached per thread for every pair of
+		/// complete object locator and target class. Objects under construction or destruction with vtordisp adjustments are not supported.
+		/// </summary>
+		/// <param name="object">: pointer to a polymorphic object (or one of its subobjects with a virtual function table), may be nullptr</param>
+		/// <param name="target">: the class to cast to, a class of this index</param>
+		/// <returns>a pointer to the target subobject, nullptr if the object is not of a class deriving from (or being) the target, or the target is ambiguous</returns>
+		void* cast(const void* object, const RTTI& target) const noexcept
+		{
+			if (!object) return nullptr;
+
+			auto pCOL = reinterpret_cast<CompleteObjectLocator* const*>(*reinterpret_cast<void** const*>(object))[-1];
+
+			CastEntry& entry = ClassIndex::getCastCache()[ClassIndex::hashPair(reinterpret_cast<uintptr_t>(pCOL) ^ reinterpret_cast<uintptr_t>(&target)) & (castCacheSize - 1)];
+			if (entry.pCOL != pCOL || entry.pTarget != &target || entry.generation != this->generation) {
+				ptrdiff_t delta = 0;
+				bool valid = this->resolveCast(object, pCOL, target, delta);
+				entry = { pCOL, &target, this->generation, delta, valid };
+			}
+
+			return entry.valid ? const_cast<char*>(reinterpret_cast<const char*>(object)) + entry.delta : nullptr;
+		}
+
+		/// <summary>
+		/// Removes all records, invalidating pointers to them. Must not be called while the index is shared with other threads.
+		/// </summary>
+		void clear()
+		{
+			this->mangledNames.clear();
+			this->demangledNames.clear();
+			this->demangledIndexBuilt.store(false);
+			this->sortedClasses.clear();
+			this->sortedNameOffsets.clear();
+			this->sortedNames.clear();
+			this->sortedIndexBuilt.store(false);
+			this->rttiArena.clear();
+			this->recordCount = 0;
+
+			this->classById.clear();
+			this->baseOffsets.clear();
+			this->baseClasses.clear();
+			this->derivedOffsets.clear();
+			this->derivedClasses.clear();
+			this->baseTable.clear();
+			this->typeTable.clear();
+			this->tableOffsets.clear();
+			this->tableEntries.clear();
+			this->slotFunctions.clear();
+			this->slotFingerprints.clear();
+			this->fingerprintsBuilt.store(false);
+			this->codeRanges = PEParser::SectionRanges();
+			this->imageBase = nullptr;
+			this->generation = ClassIndex::nextGeneration++;
+		}
+
+	private:
+		// An entry of an open addressing name table. Empty entries have a null RTTI pointer.
+		struct IndexEntry {
+			RTTI* pRTTI;
+			unsigned int hash;
+			unsigned int nameOffset;
+			unsigned int nameLength;
+		};
+
+		// Interned names indexed with linear probing, keyed by string views so that lookups never allocate.
+		struct NameTable {
+			/// <summary>
+			/// Finds the entry of a name, or the empty entry where it would be inserted.
+			/// </summary>
+			/// <returns>a pointer to the entry, nullptr if the table has not been allocated</returns>
+			IndexEntry* find(std::string_view name, unsigned int hash) noexcept
+			{
+				if (this->entries.empty()) return nullptr;
+
+				const size_t mask = this->entries.size() - 1;
+				for (size_t i = hash & mask;; i = (i + 1) & mask) {
+					IndexEntry& entry = this->entries[i];
+					if (!entry.pRTTI) return &entry;
+					if (entry.hash == hash && entry.nameLength == name.size()
+						&& !memcmp(this->names.data() + entry.nameOffset, name.data(), name.size())) return &entry;
+				}
+			}
+
+			// Fills an empty entry returned by NameTable::find, the table must have been reserved for it.
+			void insert(IndexEntry* entry, std::string_view name, unsigned int hash, RTTI* pRTTI)
+			{
+				*entry = { pRTTI, hash, static_cast<unsigned int>(this->names.size()), static_cast<unsigned int>(name.size()) };
+				this->names.insert(this->names.end(), name.begin(), name.end());
+				this->names.push_back('\0');
+			}
+
+			// Grows the table to hold a total amount of names at most half full.
+			void reserve(size_t total)
+			{
+				size_t tableSize = this->entries.empty() ? 1024 : this->entries.size();
+				while (tableSize < total * 2) tableSize *= 2;
+
+				if (tableSize != this->entries.size()) {
+					std::vector<IndexEntry> oldEntries(tableSize, IndexEntry{});
+					oldEntries.swap(this->entries);
+
+					const size_t mask = tableSize - 1;
+					for (IndexEntry& entry : oldEntries) {
+						if (!entry.pRTTI) continue;
+
+						size_t i = entry.hash & mask;
+						while (this->entries[i].pRTTI) i = (i + 1) & mask;
+						this->entries[i] = entry;
+					}
+				}
+
+				// mangled class names are rarely longer than this on average
+				if (total * 32 > this->names.capacity()) this->names.reserve(total * 32);
+			}
+
+			void clear()
+			{
+				this->entries.clear();
+				this->names.clear();
+			}
+
+			std::vector<char> names; // Null terminated names.
+			std::vector<IndexEntry> entries; // The size is always a power of two.
+		};
+
+		// A (derived, base) pair of the hierarchy index, keyed by both class ids. Empty entries have a zero key.
+		struct BaseEntry {
+			unsigned long long key;
+			unsigned int baseIndex; // index of the first entry of base in baseClasses
+			unsigned int count;
+		};
+
+		static unsigned long long getPairKey(unsigned int derivedId, unsigned int baseId) noexcept
+		{
+			// offset by one so that no valid pair has a zero key
+			return (static_cast<unsigned long long>(derivedId) << 32 | baseId) + 1;
+		}
+
+		static size_t hashPair(unsigned long long key) noexcept
+		{
+			key ^= key >> 33;
+			key *= 0xFF51AFD7ED558CCDull;
+			key ^= key >> 33;
+			return static_cast<size_t>(key);
+		}
+
+		bool owns(const RTTI& rtti) const noexcept
+		{
+			return rtti.classId < this->classById.size() && this->classById[rtti.classId] == &rtti;
+		}
+
+		const BaseEntry* findBaseEntry(const RTTI& derived, const RTTI& base) const noexcept
+		{
+			if (this->baseTable.empty() || !this->owns(derived) || !this->owns(base)) return nullptr;
+
+			const unsigned long long key = ClassIndex::getPairKey(derived.classId, base.classId);
+			const size_t mask = this->baseTable.size() - 1;
+			for (size_t i = ClassIndex::hashPair(key) & mask;; i = (i + 1) & mask) {
+				const BaseEntry& entry = this->baseTable[i];
+				if (entry.key == key) return &entry;
+				if (!entry.key) return nullptr;
+			}
+		}
+
+		// A type descriptor of the hierarchy index, mapped to its class id. Empty entries have a null type descriptor.
+		struct TypeEntry {
+			const TypeDescriptor* pTypeDescriptor;
+			unsigned int classId;
+		};
+
+		// The class of a virtual function table, the offset of the subobject using it and the range of its functions in slotFunctions.
+		struct TableEntry {
+			unsigned int classId;
+			unsigned int offset;
+			unsigned int functionCount;
+			unsigned int firstSlot;
+		};
+
+		// A resolved cast, the offset from the source subobject to the target subobject.
+		struct CastEntry {
+			const CompleteObjectLocator* pCOL;
+			const RTTI* pTarget;
+			unsigned long long generation;
+			ptrdiff_t delta;
+			bool valid;
+		};
+
+		static constexpr size_t castCacheSize = 256;
+
+		// direct mapped, a collision evicts the previous entry
+		static CastEntry* getCastCache() noexcept
+		{
+			static thread_local CastEntry cache[castCacheSize]{};
+			return cache;
+		}
+
+		bool resolveCast(const void* object, const CompleteObjectLocator* pCOL, const RTTI& target, ptrdiff_t& delta) const noexcept
+		{
+			if (!this->owns(target) || pCOL->signature != 1) return false;
+
+			PEParser::ibo32 iboTypeDescriptor = pCOL->iboTypeDescriptor;
+			RTTI* complete = this->findByTypeDescriptor(iboTypeDescriptor.as<TypeDescriptor*>(this->imageBase));
+			if (!complete) return false;
+
+			// the locator gives the offset of the subobject inside of the complete object
+			const char* completeObject = reinterpret_cast<const char*>(object) - pCOL->offset;
+			if (complete == &target) {
+				delta = -static_cast<ptrdiff_t>(pCOL->offset);
+				return true;
+			}
+
+			unsigned int count = 0;
+			const BaseClass* base = this->findBaseClass(*complete, target, &count);
+			if (!base || (base->attributes & (ClassIndex::baseNotVisible | ClassIndex::baseAmbiguous))) return false;
+
+			// a base reached through several paths is only unambiguous if it is virtual, with a single subobject
+			if (count > 1 && base->pdisp < 0) return false;
+
+			ptrdiff_t offset = base->mdisp;
+			if (base->pdisp >= 0) {
+				// virtual bases are located through the virtual base table, whose layout is fixed for the complete class
+				const char* vbtable = *reinterpret_cast<const char* const*>(completeObject + base->pdisp);
+				offset += base->pdisp + *reinterpret_cast<const int*>(vbtable + base->vdisp);
+			}
+
+			delta = offset - static_cast<ptrdiff_t>(pCOL->offset);
+			return true;
+		}
+
+		// BaseClassDescriptor attributes
+		static constexpr unsigned int baseNotVisible = 0x01;
+		static constexpr unsigned int baseAmbiguous = 0x02;
+
+		static inline std::atomic<unsigned long long> nextGeneration{ 1 };
+
+		// The reverse index entry of a table, by binary search over the table offsets.
+		const TableEntry* findTable(const void* pVirtualFunctionTable) const noexcept
+		{
+			// addresses below the image base wrap around to offsets larger than any table offset
+			uintptr_t offset = reinterpret_cast<uintptr_t>(pVirtualFunctionTable) - reinterpret_cast<uintptr_t>(this->imageBase);
+			if (this->tableOffsets.empty() || offset > this->tableOffsets.back()) return nullptr;
+
+			auto iter = std::lower_bound(this->tableOffsets.begin(), this->tableOffsets.end(), static_cast<unsigned int>(offset));
+			if (iter == this->tableOffsets.end() || *iter != offset) return nullptr;
+
+			return &this->tableEntries[iter - this->tableOffsets.begin()];
+		}
+
+		// Checks if an address is in committed executable memory, reusing the last queried region if it contains the address.
+		static bool isExecutable(const void* address, MEMORY_BASIC_INFORMATION& region) noexcept
+		{
+			if (!address) return false;
+
+			if (reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(region.BaseAddress) >= region.RegionSize) {
+				if (!VirtualQuery(address, &region, sizeof(region))) return false;
+			}
+
+			return region.State == MEM_COMMIT && (region.Protect & (PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY));
+		}
+
+		// The hash of the first (up to) 16 bytes of code at an offset from the image base, never reading past the end of its section.
+		unsigned int fingerprintOffset(uintptr_t offset) const noexcept
+		{
+			for (const PEParser::SectionRanges::Range& range : this->codeRanges.getRanges()) {
+				if (offset - range.start >= range.size) continue;
+
+				const size_t length = (std::min)(static_cast<size_t>(range.start + range.size - offset), static_cast<size_t>(16));
+				return RTTIScanner::hashName(std::string_view(reinterpret_cast<const char*>(this->imageBase + offset), length));
+			}
+			return 0;
+		}
+
+		// Must be called with fingerprintMutex held.
+		void buildFingerprints() const
+		{
+			this->slotFingerprints.resize(this->slotFunctions.size());
+			for (size_t i = 0; i < this->slotFunctions.size(); ++i) {
+				this->slotFingerprints[i] = this->slotFunctions[i] ? this->fingerprintOffset(this->slotFunctions[i]) : 0;
+			}
+
+			this->fingerprintsBuilt.store(true, std::memory_order_release);
+		}
+
+		void requireSortedIndex()
+		{
+			if (this->sortedIndexBuilt.load(std::memory_order_acquire)) return;
+
+			std::lock_guard<std::mutex> lock(this->sortedMutex);
+			if (!this->sortedIndexBuilt.load(std::memory_order_relaxed)) this->buildSortedIndex();
+		}
+
+		// The demangled name of the i-th class of the sorted name index. Names are null terminated inside of the buffer.
+		std::string_view getSortedName(unsigned int i) const noexcept
+		{
+			return std::string_view(this->sortedNames.data() + this->sortedNameOffsets[i], this->sortedNameOffsets[i + 1] - this->sortedNameOffsets[i] - 1);
+		}
+
+		// Must be called with sortedMutex held.
+		void buildSortedIndex()
+		{
+			std::vector<std::pair<std::string, RTTI*>> names;
+			names.reserve(this->recordCount);
+
+			this->forEach([&names](RTTI& rtti) {
+				char name[sizeof(TypeDescriptor::name)];
+				size_t length = RTTIScanner::unmangleName(rtti.getMangledName(), name, sizeof(name));
+				std::string demangled = length ? std::string(name, length) : rtti.getName();
+				if (!demangled.empty()) names.emplace_back(std::move(demangled), &rtti);
+			});
+			std::stable_sort(names.begin(), names.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+			this->sortedClasses.clear();
+			this->sortedNameOffsets.assign(1, 0);
+			this->sortedNames.clear();
+			this->sortedClasses.reserve(names.size());
+			this->sortedNameOffsets.reserve(names.size() + 1);
+			for (auto& [name, pRTTI] : names) {
+				this->sortedClasses.push_back(pRTTI);
+				this->sortedNames.insert(this->sortedNames.end(), name.begin(), name.end());
+				this->sortedNames.push_back('\0');
+				this->sortedNameOffsets.push_back(static_cast<unsigned int>(this->sortedNames.size()));
+			}
+			// vector loads starting inside of the last name stay inside of the buffer
+			this->sortedNames.resize(this->sortedNames.size() + ClassIndex::namePadding, '\0');
+
+			this->sortedIndexBuilt.store(true, std::memory_order_release);
+		}
+
+		static constexpr size_t namePadding = 32;
+
+		// Matches a name of the sorted name index against a wildcard pattern, whose first wildcard is at a given position.
+		static bool matchPattern(std::string_view name, std::string_view pattern, size_t literal) noexcept
+		{
+			const size_t firstStar = pattern.find('*');
+			if (firstStar == std::string_view::npos) return name.size() == pattern.size() && ClassIndex::matchSegment(name.data(), pattern);
+
+			// the segments before the first and after the last '*' are anchored to the start and the end of the name
+			const size_t lastStar = pattern.rfind('*');
+			std::string_view head = pattern.substr(0, firstStar);
+			std::string_view tail = pattern.substr(lastStar + 1);
+			if (name.size() < head.size() + tail.size()) return false;
+			if (!ClassIndex::matchSegment(name.data() + literal, head.substr(literal))) return false;
+			if (!ClassIndex::matchSegment(name.data() + name.size() - tail.size(), tail)) return false;
+
+			// the segments in between are matched at their leftmost position, which leaves the most room for the next ones
+			size_t position = head.size();
+			const size_t end = name.size() - tail.size();
+			for (size_t i = firstStar + 1; i < lastStar + 1;) {
+				const size_t next = pattern.find('*', i);
+				std::string_view segment = pattern.substr(i, next - i);
+				i = next + 1;
+				if (segment.empty()) continue;
+
+				position = ClassIndex::findSegment(name.data(), position, end, segment);
+				if (position == std::string_view::npos) return false;
+				position += segment.size();
+			}
+			return true;
+		}
+
+		static bool matchSegment(const char* text, std::string_view segment) noexcept
+		{
+			for (size_t i = 0; i < segment.size(); ++i) {
+				if (segment[i] != '?' && segment[i] != text[i]) return false;
+			}
+			return true;
+		}
+
+		// The leftmost position in [position, end - segment size] where a segment matches, std::string_view::npos if there is none.
+		static size_t findSegment(const char* name, size_t position, size_t end, std::string_view segment) noexcept
+		{
+			while (position + segment.size() <= end) {
+				// a segment starting with a literal character only needs to be compared where the character is
+				if (segment[0] != '?') {
+					position = ClassIndex::findCharacter(name, position, end - segment.size() + 1, segment[0]);
+					if (position == std::string_view::npos) return position;
+				}
+				if (ClassIndex::matchSegment(name + position, segment)) return position;
+				++position;
+			}
+			return std::string_view::npos;
+		}
+
+		// The first position of a character in [position, end), std::string_view::npos if there is none.
+		// Reads up to 31 bytes past the end, which the padding of the name buffer allows for.
+		static size_t findCharacter(const char* name, size_t position, size_t end, char character) noexcept
+		{
+			switch (RTTIScanner::getSIMDLevel()) {
+			case SIMDLevel::AVX2: {
+				const __m256i needle = _mm256_set1_epi8(character);
+				for (; position < end; position += 32) {
+					unsigned long bits = static_cast<unsigned long>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(name + position)), needle)));
+					unsigned long lane;
+					if (_BitScanForward(&lane, bits)) return position + lane < end ? position + lane : std::string_view::npos;
+				}
+				return std::string_view::npos;
+			}
+			case SIMDLevel::SSE42: {
+				const __m128i needle = _mm_set1_epi8(character);
+				for (; position < end; position += 16) {
+					unsigned long bits = static_cast<unsigned long>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(name + position)), needle)));
+					unsigned long lane;
+					if (_BitScanForward(&lane, bits)) return position + lane < end ? position + lane : std::string_view::npos;
+				}
+				return std::string_view::npos;
+			}
+			default:
+				for (; position < end; ++position) {
+					if (name[position] == character) return position;
+				}
+				return std::string_view::npos;
+			}
+		}
+
+		// Must be called with demangledMutex held.
+		void buildDemangledIndex()
+		{
+			this->demangledNames.reserve(this->recordCount);
+
+			// the arena is in insertion order, so the first class with a given demangled name wins like in the mangled index
+			this->forEach([this](RTTI& rtti) {
+				std::string name = rtti.getName();
+				if (name.empty()) return;
+
+				unsigned int hash = RTTIScanner::hashName(name);
+				IndexEntry* entry = this->demangledNames.find(name, hash);
+				if (!entry->pRTTI) this->demangledNames.insert(entry, name, hash, &rtti);
+			});
+
+			this->demangledIndexBuilt.store(true, std::memory_order_release);
+		}
+
+		std::vector<std::vector<RTTI>> rttiArena;
+		NameTable mangledNames;
+		size_t recordCount;
+
+		NameTable demangledNames;
+		std::atomic<bool> demangledIndexBuilt;
+		std::mutex demangledMutex;
+
+		// the sorted name index, classes sorted by demangled name with their names in one contiguous buffer
+		std::vector<RTTI*> sortedClasses;
+		std::vector<unsigned int> sortedNameOffsets; // the name of sortedClasses[i] starts at sortedNameOffsets[i], followed by the next name's start
+		std::vector<char> sortedNames;
+		std::atomic<bool> sortedIndexBuilt;
+		std::mutex sortedMutex;
+
+		// the hierarchy index, flat arrays indexed by class id
+		std::vector<RTTI*> classById;
+		std::vector<unsigned int> baseOffsets; // the bases of class i are baseClasses[baseOffsets[i]] to baseClasses[baseOffsets[i + 1] - 1]
+		std::vector<BaseClass> baseClasses;
+		std::vector<unsigned int> derivedOffsets; // likewise for derivedClasses
+		std::vector<unsigned int> derivedClasses;
+		std::vector<BaseEntry> baseTable; // linear probing, the size is always a power of two
+		std::vector<TypeEntry> typeTable; // likewise
+
+		// the reverse index, sorted virtual function table offsets with a parallel array of their classes
+		std::vector<unsigned int> tableOffsets;
+		std::vector<TableEntry> tableEntries;
+
+		// the functions of every table as offsets from the image base (0 outside of the image), their fingerprints are computed on demand
+		std::vector<unsigned int> slotFunctions;
+		PEParser::SectionRanges codeRanges;
+		mutable std::vector<unsigned int> slotFingerprints;
+		mutable std::atomic<bool> fingerprintsBuilt;
+		mutable std::mutex fingerprintMutex;
+
+		unsigned char* imageBase;
+		unsigned long long generation; // tells cached casts of an index apart from those of an index previously at the same address
+	};
+
+	RTTIScanner() { RTTIScanner::parser.reset(new PEParser()); }
+	~RTTIScanner() { RTTIScanner::parser.reset(); RTTIScanner::clearClasses(); RTTIScanner::sectionData.reset(); }
+
+	/// <summary>
+	/// Scans the executable's text section(s) to retrieve class RTTI by matching instruction patterns inside class object constructors.
+	/// RTTI structs are stored contiguously and indexed by their mangled class names.
+	/// Class names are not demangled during the scan, see RTTIScanner::getClassRTTI.
+	/// Optionally, the .rdata section(s) can be split into chunks and validated on multiple worker threads.
+	/// Demangling and mapping are always done on the calling thread in address order, so the resulting map is identical to a serial scan.
+	/// The class map is built on the side and published atomically, lookups running concurrently with a rescan see either the old or the new map.
+	/// A parallel scan must not be started while holding the loader lock (e.g. from DllMain), as the worker threads would not be able to start.
+	/// </summary>
+	/// <param name="pInfo">: (optional) a pointer to a PEParser::ProcessInfo struct overriding the default process information used by the parser,
+	/// e.g. PEParser::MappedImage::createProcessInfo to scan an image file without running it</param>
+	/// <param name="threadCount">: (optional) the amount of threads to scan on, 1 by default (the calling thread only), 0 to use all hardware threads</param>
+	/// <returns>true on success, false on initialization failure</returns>
+	bool scan(PEParser::ProcessInfo* pInfo = nullptr, unsigned int threadCount = 1)
+	{
+		// parse the PE headers and get section addresses and process information
+		if (!RTTIScanner::parser->parse(pInfo) || !this->setSectionData()) return false;
+
+		auto processInfo = this->parser->getProcessInfo();
+		if (!processInfo) return false;
+
+		//get executable base address and sections
+		unsigned char* base = reinterpret_cast<unsigned char*>(processInfo->mInfo->lpBaseOfDll);
+
+		PEParser::PESections* text = this->sectionData->text;
+		PEParser::PESections* data = this->sectionData->data;
+		PEParser::PESections* rdata = this->sectionData->rdata;
+
+		if (!text || !data || !rdata) return false;
+
+		// the range tables are built alongside the section lists and cannot be missing if the lists are present
+		const PEParser::SectionRanges& textRanges = *this->sectionData->textRanges;
+		const PEParser::SectionRanges& dataRanges = *this->sectionData->dataRanges;
+		const PEParser::SectionRanges& rdataRanges = *this->sectionData->rdataRanges;
+		const PEParser::SectionRanges& codeRanges = RTTIScanner::getCodeRanges(*RTTIScanner::parser->getExecutableRanges(), textRanges);
+
+		// a cache file matching the image makes the scan unnecessary
+		std::string cachePath = this->getCachePath();
+		if (!cachePath.empty() && this->loadCache(cachePath, base, dataRanges, rdataRanges, codeRanges)) return true;
+
+		std::vector<CompleteObjectLocator**> candidates = RTTIScanner::findCandidates(base, *rdata, textRanges, dataRanges, rdataRanges, threadCount);
+
+		// map the candidates in address order, the first VFT found for a class is kept
+		std::unique_ptr<ClassIndex> classes(new ClassIndex());
+		classes->reserve(candidates.size());
+		for (auto pCOL : candidates) RTTIScanner::addCandidate(*classes, pCOL, base);
+		classes->buildHierarchy(base, dataRanges, rdataRanges);
+		classes->buildVirtualFunctionTableIndex(candidates, codeRanges);
+
+		ClassIndex& published = RTTIScanner::publish(std::move(classes));
+		if (!cachePath.empty()) this->saveCache(cachePath, base, published, candidates);
+
+		return true;
+	}
+
+	/// <summary>
+	/// Scans a loaded image into a separate class map, without using or modifying the scanner's own class map or cache.
+	/// Images may be scanned concurrently, each into its own class map. Used by RTTIRegistry to scan modules besides the executable.
+	/// </summary>
+	/// <param name="classes">: an empty class map to fill</param>
+	/// <param name="sections">: the section map of the image, see PEParser::parseImage</param>
+	/// <param name="imageBase">: image base address</param>
+	/// <param name="threadCount">: (optional) the amount of threads to scan on, 1 by default (the calling thread only), 0 to use all hardware threads</param>
+	/// <returns>true on success, false if the image is missing a .text, .data or .rdata section</returns>
+	static bool scanImage(ClassIndex& classes, PEParser::SectionMap& sections, void* imageBase, unsigned int threadCount = 1)
+	{
+		unsigned char* base = reinterpret_cast<unsigned char*>(imageBase);
+
+		PEParser::PESections* rdata = sections.getSectionsWithName(".rdata");
+		const PEParser::SectionRanges* textRanges = sections.getSectionRangesWithName(".text");
+		const PEParser::SectionRanges* dataRanges = sections.getSectionRangesWithName(".data");
+		const PEParser::SectionRanges* rdataRanges = sections.getSectionRangesWithName(".rdata");
+
+		if (!rdata || !textRanges || !dataRanges || !rdataRanges) return false;
+
+		std::vector<CompleteObjectLocator**> candidates = RTTIScanner::findCandidates(base, *rdata, *textRanges, *dataRanges, *rdataRanges, threadCount);
+
+		classes.reserve(candidates.size());
+		for (auto pCOL : candidates) RTTIScanner::addCandidate(classes, pCOL, base);
+		classes.buildHierarchy(base, *dataRanges, *rdataRanges);
+		classes.buildVirtualFunctionTableIndex(candidates, RTTIScanner::getCodeRanges(sections.getExecutableRanges(), *textRanges));
+
+		return true;
+	}
+
+	/// <summary>
+	/// Enables the on-disk scan cache. RTTIScanner::scan will rebuild the class map from the cache file
+	/// if it matches the image's timestamp, checksum and size, otherwise it scans and rewrites the file.
+	/// </summary>
+	/// <param name="path">: (optional) path to the cache file, by default the module's path with a ".rtticache" extension appended</param>
+	void enableCache(std::string path = "")
+	{
+		this->cacheEnabled = true;
+		this->cachePath = std::move(path);
+	}
+
+	/// <summary>
+	/// Disables the on-disk scan cache. Existing cache files are left untouched.
+	/// </summary>
+	void disableCache()
+	{
+		this->cacheEnabled = false;
+		this->cachePath.clear();
+	}
+
+	/// <summary>
+	/// Calls a function for every scanned class, in the order they were found.
+	/// </summary>
+	/// <param name="function">: a function taking an RTTIScanner::RTTI reference</param>
+	template <typename F> static void forEachClassRTTI(F&& function)
+	{
+		if (ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire)) classes->forEach(function);
+	}
+
+	/// <summary>
+	/// Retrieves the amount of scanned classes.
+	/// </summary>
+	/// <returns>the amount of classes with RTTI</returns>
+	static size_t getClassCount() noexcept
+	{
+		ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire);
+		return classes ? classes->size() : 0;
+	}
+
+	/// <summary>
+	/// Retrieves a pointer to the RTTI of a class after a scan, by name.
+	/// Accepts both mangled (".?AVPlayerIns@CS@@") and demangled ("CS::PlayerIns") names.
+	/// Plain demangled names are mangled and looked up directly, only names that cannot be mangled this way
+	/// (templates, anonymous namespaces etc.) demangle all scanned classes once to build a secondary index.
+	/// Lock free and safe to call from any thread, including while a rescan is running.
+	/// </summary>
+	/// <param name="name">: name of the class to get RTTI of</param>
+	/// <returns>a pointer to class RTTI on success, otherwise nullptr. The pointer stays valid until the scanner is destroyed</returns>
+	static RTTI* getClassRTTI(std::string_view name)
+	{
+		ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire);
+		return classes ? classes->find(name) : nullptr;
+	}
+
+	/// <summary>
+	/// Retrieves every scanned class whose demangled name starts with a prefix, e.g. "CS::ChrIns", see RTTIScanner::ClassIndex::findByPrefix.
+	/// </summary>
+	/// <param name="prefix">: the start of the demangled names</param>
+	/// <returns>the matching classes sorted by demangled name, empty if there are none. The span stays valid until the scanner is destroyed</returns>
+	static ClassSpan getClassesWithPrefix(std::string_view prefix)
+	{
+		ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire);
+		return classes ? classes->findByPrefix(prefix) : ClassSpan{ nullptr, nullptr };
+	}
+
+	/// <summary>
+	/// Retrieves every scanned class whose demangled name matches a wildcard pattern, e.g. "CS::*Ins", see RTTIScanner::ClassIndex::findMatching.
+	/// </summary>
+	/// <param name="pattern">: the wildcard pattern, '*' matches any run of characters and '?' any single one</param>
+	/// <returns>pointers to the RTTI of the matching classes sorted by demangled name, empty if there are none</returns>
+	static std::vector<RTTI*> findClasses(std::string_view pattern)
+	{
+		std::vector<RTTI*> results;
+		if (ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire)) classes->findMatching(pattern, results);
+		return results;
+	}
+
+	/// <summary>
+	/// Checks if a scanned class is derived from another scanned class, directly or indirectly.
+	/// Answered from the hierarchy index built during the scan, see RTTIScanner::ClassIndex::buildHierarchy.
+	/// </summary>
+	/// <param name="derivedName">: name of the derived class</param>
+	/// <param name="baseName">: name of the base class</param>
+	/// <returns>true if both classes were found and the second is a base of the first, otherwise false</returns>
+	static bool isDerivedFrom(std::string_view derivedName, std::string_view baseName)
+	{
+		ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire);
+		if (!classes) return false;
+
+		RTTI* pDerived = classes->find(derivedName);
+		RTTI* pBase = classes->find(baseName);
+		return pDerived && pBase && classes->isDerivedFrom(*pDerived, *pBase);
+	}
+
+	/// <summary>
+	/// Retrieves every scanned class derived from a class, directly or indirectly.
+	/// Answered from the hierarchy index built during the scan, see RTTIScanner::ClassIndex::buildHierarchy.
+	/// </summary>
+	/// <param name="baseName">: name of the base class</param>
+	/// <returns>pointers to the RTTI of the derived classes in the order they were found, empty if there are none or the class was not found</returns>
+	static std::vector<RTTI*> allDerived(std::string_view baseName)
+	{
+		ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire);
+		if (!classes) return {};
+
+		RTTI* pBase = classes->find(baseName);
+		return pBase ? classes->allDerived(*pBase) : std::vector<RTTI*>{};
+	}
+
+	/// <summary>
+	/// Retrieves the scanned class owning a virtual function table, secondary tables of multiply inherited classes included.
+	/// Answered from the reverse index built during the scan, see RTTIScanner::ClassIndex::findByVirtualFunctionTable.
+	/// </summary>
+	/// <param name="pVirtualFunctionTable">: pointer to a virtual function table</param>
+	/// <param name="pOffset">: (optional) receives the offset of the subobject using the table inside of the complete object, 0 for primary tables</param>
+	/// <returns>a pointer to the RTTI of the complete class, nullptr if the table was not found by the scan</returns>
+	static RTTI* getClassRTTIFromVFT(const void* pVirtualFunctionTable, unsigned int* pOffset = nullptr)
+	{
+		ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire);
+		return classes ? classes->findByVirtualFunctionTable(pVirtualFunctionTable, pOffset) : nullptr;
+	}
+
+	/// <summary>
+	/// Identifies the concrete class of a polymorphic object by its virtual function table pointer, see RTTIScanner::getClassRTTIFromVFT.
+	/// </summary>
+	/// <param name="object">: pointer to a polymorphic object or one of its subobjects with a virtual function table</param>
+	/// <param name="pOffset">: (optional) receives the offset of the subobject inside of the complete object</param>
+	/// <returns>a pointer to the RTTI of the complete class, nullptr if the object is nullptr or its table was not found by the scan</returns>
+	static RTTI* getClassRTTIFromObject(const void* object, unsigned int* pOffset = nullptr)
+	{
+		return object ? RTTIScanner::getClassRTTIFromVFT(*reinterpret_cast<void* const*>(object), pOffset) : nullptr;
+	}
+
+	/// <summary>
+	/// Casts a polymorphic object to a scanned class by name, like dynamic_cast to a pointer. See RTTIScanner::ClassIndex::cast.
+	/// Cheap enough to call on every invocation of a hook: a single name lookup and, after the first cast of a kind, a per-thread cache hit.
+	/// </summary>
+	/// <param name="object">: pointer to a polymorphic object, e.g. the "this" argument of a hooked virtual function</param>
+	/// <param name="className">: mangled or demangled name of the class to cast to</param>
+	/// <returns>a pointer to the class subobject on success, otherwise nullptr</returns>
+	static void* castTo(const void* object, std::string_view className)
+	{
+		ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire);
+		if (!classes || !object) return nullptr;
+
+		RTTI* pTarget = classes->find(className);
+		return pTarget ? classes->cast(object, *pTarget) : nullptr;
+	}
+
+	/// <summary>
+	/// Casts a polymorphic object to a scanned class, like dynamic_cast to a pointer. See RTTIScanner::castTo.
+	/// The class is looked up by the mangled name the compiler gives its type_info, it has to be declared with the same name as in the scanned image.
+	/// </summary>
+	/// <typeparam name="T">: the class to cast to</typeparam>
+	/// <param name="object">: pointer to a polymorphic object, e.g. the "this" argument of a hooked virtual function</param>
+	/// <returns>a pointer to the class subobject on success, otherwise nullptr</returns>
+	template <typename T> static T* cast(const void* object)
+	{
+		ClassIndex* classes = RTTIScanner::classes.load(std::memory_order_acquire);
+		if (!classes || !object) return nullptr;
+
+		// the target is looked up once per thread and class map
+		static thread_local unsigned long long generation = 0;
+		static thread_local RTTI* pTarget = nullptr;
+		if (generation != classes->getGeneration()) {
+			pTarget = classes->findMangled(typeid(T).raw_name());
+			generation = classes->getGeneration();
+		}
+
+		return pTarget ? static_cast<T*>(classes->cast(object, *pTarget)) : nullptr;
+	}
+
+	/// <summary>
+	/// Retrieves the class map of the last scan, for direct access to its hierarchy index.
+	/// </summary>
+	/// <returns>a pointer to the class map, nullptr if no scan has completed. The pointer stays valid until the scanner is destroyed</returns>
+	static ClassIndex* getClassIndex() noexcept { return RTTIScanner::classes.load(std::memory_order_acquire); }
+
+private:
+	static inline std::unique_ptr<PEParser> parser{};
+
+	// The current class map of the scanned image. Replaced maps are kept until the scanner is destroyed,
+	// so that lookups which loaded them and the records they returned stay valid.
+	static inline std::atomic<ClassIndex*> classes{ nullptr };
+	static inline std::vector<std::unique_ptr<ClassIndex>> retiredClasses{};
+	static inline std::mutex classesMutex{};
+	static inline std::unique_ptr<SectionData> sectionData{};
+
+	// REX.W lea reg1,[rip]
+	// REX.W mov [reg2],reg1
+	const __m128i signature = _mm_setr_epi8(0x48, 0x8D, 0x05, 0x0, 0x0, 0x0, 0x0, 0x48, 0x89, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0);
+	const __m128i bitmask = _mm_setr_epi8(0b00000100, 0, 0b00111000, -1, -1, -1, -1, 0b00000101, 0, 0b00111111, -1, -1, -1, -1, -1, -1);
+
+	static ClassIndex& publish(std::unique_ptr<ClassIndex> classes)
+	{
+		std::lock_guard<std::mutex> lock(RTTIScanner::classesMutex);
+
+		ClassIndex& published = *classes;
+		RTTIScanner::retiredClasses.push_back(std::move(classes));
+		RTTIScanner::classes.store(&published, std::memory_order_release);
+		return published;
+	}
+
+	static void clearClasses()
+	{
+		std::lock_guard<std::mutex> lock(RTTIScanner::classesMutex);
+
+		RTTIScanner::classes.store(nullptr);
+		RTTIScanner::retiredClasses.clear();
+	}
+
+	bool setSectionData()
+	{
+		RTTIScanner::sectionData.reset();
+
+		PEParser::PESections* text = RTTIScanner::parser->getSectionsWithName(".text");
+		PEParser::PESections* data = RTTIScanner::parser->getSectionsWithName(".data");
+		PEParser::PESections* rdata = RTTIScanner::parser->getSectionsWithName(".rdata");
+
+		const PEParser::SectionRanges* textRanges = RTTIScanner::parser->getSectionRangesWithName(".text");
+		const PEParser::SectionRanges* dataRanges = RTTIScanner::parser->getSectionRangesWithName(".data");
+		const PEParser::SectionRanges* rdataRanges = RTTIScanner::parser->getSectionRangesWithName(".rdata");
+
+		if (!text || !data || !rdata || !textRanges || !dataRanges || !rdataRanges) return false;
+
+		RTTIScanner::sectionData.reset(new SectionData(text, data, rdata, textRanges, dataRanges, rdataRanges));
+
+		return true;
+	}
+
+	/// <summary>
+	/// Static. Selects the ranges virtual functions of an image may point into: all of its executable sections,
+	/// or its .text sections if no section is flagged executable.
+	/// </summary>
+	static const PEParser::SectionRanges& getCodeRanges(const PEParser::SectionRanges& executableRanges, const PEParser::SectionRanges& textRanges) noexcept
+	{
+		return executableRanges.getRanges().empty() ? textRanges : executableRanges;
+	}
+
+	// FNV-1a
+	static unsigned int hashName(std::string_view name) noexcept
+	{
+		unsigned int hash = 2166136261u;
+		for (char c : name) {
+			hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+		}
+		return hash;
+	}
+
+	/// <summary>
+	/// Mangles a plain, possibly namespace qualified class name ("CS::PlayerIns" -> ".?AVPlayerIns@CS@@").
+	/// </summary>
+	/// <param name="name">: the demangled name</param>
+	/// <param name="mangled">: receives the mangled name with the class type prefix, not null terminated</param>
+	/// <param name="size">: the size of the mangled name buffer</param>
+	/// <returns>the length of the mangled name on success, 0 if the name contains anything but identifiers and scope operators or does not fit</returns>
+	static size_t mangleName(std::string_view name, char* mangled, size_t size)
+	{
+		// every "::" becomes a single '@', the type prefix and the two trailing '@' add 6 characters at most
+		if (name.empty() || name.size() + 6 > size) return 0;
+
+		memcpy(mangled, ".?AV", 4);
+		size_t length = 4;
+
+		size_t end = name.size();
+		while (end) {
+			size_t start = name.rfind("::", end - 1);
+			start = start == std::string_view::npos || start + 2 > end ? 0 : start + 2;
+
+			std::string_view part = name.substr(start, end - start);
+			if (part.empty() || (part[0] >= '0' && part[0] <= '9')) return 0;
+			for (char c : part) {
+				if (!(c == '_' || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))) return 0;
+			}
+
+			memcpy(mangled + length, part.data(), part.size());
+			length += part.size();
+			mangled[length++] = '@';
+
+			if (!start) break;
+			if (start < 2) return 0;
+			end = start - 2;
+			if (!end) return 0;
+		}
+
+		mangled[length++] = '@';
+		return length;
+	}
+
+	/// <summary>
+	/// Demangles a plain mangled class name (".?AVPlayerIns@CS@@" -> "CS::PlayerIns") without DbgHelp, the reverse of RTTIScanner::mangleName.
+	/// </summary>
+	/// <param name="mangled">: the mangled name with its type prefix</param>
+	/// <param name="name">: receives the demangled name, not null terminated</param>
+	/// <param name="size">: the size of the name buffer</param>
+	/// <returns>the length of the demangled name on success, 0 if the name has templates, back references or anything but identifiers, or does not fit</returns>
+	static size_t unmangleName(std::string_view mangled, char* name, size_t size)
+	{
+		if (mangled.size() < 7 || mangled.compare(0, 3, ".?A") || (mangled[3] != 'V' && mangled[3] != 'U') || mangled.compare(mangled.size() - 2, 2, "@@")) return 0;
+
+		// the parts are stored innermost first, each followed by '@'
+		std::string_view parts[32];
+		size_t partCount = 0;
+		size_t total = 0;
+		for (size_t start = 4, end; start < mangled.size() - 1; start = end + 1) {
+			end = mangled.find('@', start);
+			std::string_view part = mangled.substr(start, end - start);
+			if (part.empty() || (part[0] >= '0' && part[0] <= '9') || partCount == 32) return 0;
+			for (char c : part) {
+				if (!(c == '_' || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))) return 0;
+			}
+
+			parts[partCount++] = part;
+			total += part.size() + 2;
+		}
+		if (!partCount || total - 2 > size) return 0;
+
+		size_t length = 0;
+		while (partCount--) {
+			memcpy(name + length, parts[partCount].data(), parts[partCount].size());
+			length += parts[partCount].size();
+			if (partCount) {
+				memcpy(name + length, "::", 2);
+				length += 2;
+			}
+		}
+
+		return length;
+	}
+
+	bool cacheEnabled = false;
+	std::string cachePath;
+
+#pragma pack(push, 1) // the cache file layout must not depend on compiler padding
+	struct CacheHeader {
+		char magic[8];
+		unsigned int version;
+		unsigned int timeDateStamp;
+		unsigned int checkSum;
+		unsigned int sizeOfImage;
+		unsigned int recordCount;
+		unsigned int namesSize;
+	};
+
+	// Names are stored in a single buffer following the record array, without null terminators.
+	struct CacheRecord {
+		PEParser::ibo32 iboVirtualFunctionTable;
+		PEParser::ibo32 iboCompleteObjectLocator;
+		unsigned int nameOffset;
+		unsigned int nameLength;
+	};
+#pragma pack(pop)
+
+	static constexpr char cacheMagic[8] = { 'R', 'T', 'T', 'I', 'H', 'o', 'o', 'k' };
+	static constexpr unsigned int cacheVersion = 2; // 2: every virtual function table of a class is stored
+
+	std::string getCachePath()
+	{
+		if (!this->cacheEnabled || !this->cachePath.empty()) return this->cachePath;
+
+		auto processInfo = PEParser::getProcessInfo();
+		if (!processInfo) return "";
+		if (!processInfo->imagePath.empty()) return processInfo->imagePath + ".rtticache";
+
+		char modulePath[MAX_PATH];
+		DWORD length = GetModuleFileNameA(processInfo->hProcessModule, modulePath, sizeof(modulePath));
+		if (!length || length == sizeof(modulePath)) return "";
+
+		return std::string(modulePath, length) + ".rtticache";
+	}
+
+	/// <summary>
+	/// Memory maps a cache file and rebuilds the class map and its indices from it.
+	/// Every record is validated against the image, a single mismatch rejects the whole file.
+	/// </summary>
+	/// <returns>true if the class map was rebuilt from the cache, otherwise false</returns>
+	bool loadCache(const std::string& path, unsigned char* base, const PEParser::SectionRanges& dataRanges, const PEParser::SectionRanges& rdataRanges, const PEParser::SectionRanges& codeRanges)
+	{
+		HANDLE hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (hFile == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize{};
+		HANDLE hMapping = nullptr;
+		if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(CacheHeader))) {
+			hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		}
+		CloseHandle(hFile);
+		if (!hMapping) return false;
+
+		const unsigned char* view = reinterpret_cast<const unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+		CloseHandle(hMapping);
+		if (!view) return false;
+
+		std::vector<CompleteObjectLocator**> records;
+		bool valid = this->readCache(view, static_cast<size_t>(fileSize.QuadPart), base, dataRanges, rdataRanges, records);
+		UnmapViewOfFile(view);
+		if (!valid) return false;
+
+		std::unique_ptr<ClassIndex> classes(new ClassIndex());
+		classes->reserve(records.size());
+		for (auto pCOL : records) RTTIScanner::addCandidate(*classes, pCOL, base);
+		classes->buildHierarchy(base, dataRanges, rdataRanges);
+		classes->buildVirtualFunctionTableIndex(records, codeRanges);
+
+		RTTIScanner::publish(std::move(classes));
+
+		return true;
+	}
+
+	bool readCache(const unsigned char* view, size_t size, unsigned char* base, const PEParser::SectionRanges& dataRanges, const PEParser::SectionRanges& rdataRanges, std::vector<CompleteObjectLocator**>& records)
+	{
+		const CacheHeader* header = reinterpret_cast<const CacheHeader*>(view);
+		PEParser::ImageInfo imageInfo = PEParser::getImageInfo();
+
+		if (memcmp(header->magic, RTTIScanner::cacheMagic, sizeof(header->magic)) || header->version != RTTIScanner::cacheVersion) return false;
+		if (header->timeDateStamp != imageInfo.timeDateStamp || header->checkSum != imageInfo.checkSum || header->sizeOfImage != imageInfo.sizeOfImage) return false;
+		if (size != sizeof(CacheHeader) + static_cast<size_t>(header->recordCount) * sizeof(CacheRecord) + header->namesSize) return false;
+
+		const CacheRecord* cacheRecords = reinterpret_cast<const CacheRecord*>(view + sizeof(CacheHeader));
+		const char* names = reinterpret_cast<const char*>(cacheRecords + header->recordCount);
+
+		records.reserve(header->recordCount);
+		for (unsigned int i = 0; i < header->recordCount; ++i) {
+			CacheRecord record = cacheRecords[i];
+			if (static_cast<size_t>(record.nameOffset) + record.nameLength > header->namesSize) return false;
+
+			// the slot preceding the VFT must point to the stored COL
+			if (!rdataRanges.contains(record.iboVirtualFunctionTable) || !rdataRanges.contains(record.iboCompleteObjectLocator)) return false;
+			auto pCOL = record.iboVirtualFunctionTable.as<CompleteObjectLocator**>(base) - 1;
+			if (*pCOL != record.iboCompleteObjectLocator.as<CompleteObjectLocator*>(base)) return false;
+			if (!RTTIScanner::isValidCandidate(pCOL, base, dataRanges, rdataRanges)) return false;
+
+			TypeDescriptor* TD = (*pCOL)->iboTypeDescriptor.as<TypeDescriptor*>(base);
+			if (strnlen(TD->name, sizeof(TD->name)) != record.nameLength || memcmp(TD->name, names + record.nameOffset, record.nameLength)) return false;
+
+			records.push_back(pCOL);
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Writes the virtual function tables of the class map to a cache file, secondary tables included.
+	/// The file is written under a temporary name and moved into place, so that concurrently starting processes never map a partially written cache.
+	/// </summary>
+	/// <param name="candidates">: the candidates the class map was built from, in address order</param>
+	/// <returns>true on success, otherwise false</returns>
+	bool saveCache(const std::string& path, unsigned char* base, ClassIndex& classes, const std::vector<CompleteObjectLocator**>& candidates)
+	{
+		// store candidates in address order, so that a reload maps classes in the same order as a scan,
+		// each class name is stored once and shared by all tables of the class
+		std::vector<CacheRecord> records;
+		std::string names;
+		std::vector<unsigned int> nameOffsets(classes.size(), ~0u);
+		records.reserve(candidates.size());
+		for (auto pCOL : candidates) {
+			RTTI* pRTTI = classes.findByTypeDescriptor((*pCOL)->iboTypeDescriptor.as<TypeDescriptor*>(base));
+			if (!pRTTI) continue;
+
+			std::string_view name = pRTTI->getMangledName();
+			if (nameOffsets[pRTTI->classId] == ~0u) {
+				nameOffsets[pRTTI->classId] = static_cast<unsigned int>(names.size());
+				names.append(name);
+			}
+
+			records.push_back({ PEParser::ibo32(pCOL + 1, base), PEParser::ibo32(*pCOL, base), nameOffsets[pRTTI->classId], static_cast<unsigned int>(name.size()) });
+		}
+
+		PEParser::ImageInfo imageInfo = PEParser::getImageInfo();
+		CacheHeader header{};
+		memcpy(header.magic, RTTIScanner::cacheMagic, sizeof(header.magic));
+		header.version = RTTIScanner::cacheVersion;
+		header.timeDateStamp = imageInfo.timeDateStamp;
+		header.checkSum = imageInfo.checkSum;
+		header.sizeOfImage = imageInfo.sizeOfImage;
+		header.recordCount = static_cast<unsigned int>(records.size());
+		header.namesSize = static_cast<unsigned int>(names.size());
+
+		std::string tempPath = path + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file) return false;
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CacheRecord));
+			file.write(names.data(), names.size());
+			if (!file) {
+				file.close();
+				DeleteFileA(tempPath.c_str());
+				return false;
+			}
+		}
+
+		if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+			DeleteFileA(tempPath.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	// The amount of slots scanned as a single unit of work by the scan workers (1 MiB of .rdata).
+	static constexpr ptrdiff_t chunkSlots = 0x20000;
+
+	/// <summary>
+	/// Finds every slot in the .rdata section(s) of an image holding a structurally valid COL followed by a VFT.
+	/// Does not demangle or map anything, so it may run for several images at once.
+	/// </summary>
+	/// <param name="base">: image base address</param>
+	/// <param name="rdata">: the .rdata section(s) of the image</param>
+	/// <param name="threadCount">: the amount of threads to scan on, 0 to use all hardware threads</param>
+	/// <returns>pointers to the candidate slots, in address order</returns>
+	static std::vector<CompleteObjectLocator**> findCandidates(unsigned char* base, PEParser::PESections& rdata, const PEParser::SectionRanges& textRanges,
+		const PEParser::SectionRanges& dataRanges, const PEParser::SectionRanges& rdataRanges, unsigned int threadCount)
+	{
+		if (!threadCount) threadCount = std::thread::hardware_concurrency();
+
+		// split the .rdata section(s) into chunks of pointer sized slots
+		struct Chunk {
+			void** begin;
+			void** end;
+			void** sectionEnd;
+		};
+
+		std::vector<Chunk> chunks;
+		for (auto& section : rdata) {
+			auto begin = section->start.as<void**>(base);
+			auto end = section->end.as<void**>(base);
+			while (begin < end) {
+				auto chunkEnd = end - begin > RTTIScanner::chunkSlots ? begin + RTTIScanner::chunkSlots : end;
+				chunks.push_back({ begin, chunkEnd, end });
+				begin = chunkEnd;
+			}
+		}
+
+		// every slot holding an .rdata pointer followed by a .text pointer is a potential COL and VFT pair,
+		// candidates passing structural validation are collected per chunk to preserve address order
+		std::vector<std::vector<CompleteObjectLocator**>> results(chunks.size());
+		auto scanChunk = [&](size_t index) {
+			const Chunk& chunk = chunks[index];
+
+			// the slot after the last one in the chunk belongs to the next chunk, but is needed to check the last candidate
+			ptrdiff_t count = (chunk.end < chunk.sectionEnd ? chunk.end + 1 : chunk.end) - chunk.begin;
+			RTTIScanner::forEachCandidate(chunk.begin, count, rdataRanges, textRanges, [&](void** pCandidate) {
+				auto pCOL = reinterpret_cast<CompleteObjectLocator**>(pCandidate);
+				if (RTTIScanner::isValidCandidate(pCOL, base, dataRanges, rdataRanges)) results[index].push_back(pCOL);
+			});
+		};
+
+		if (threadCount <= 1 || chunks.size() <= 1) {
+			for (size_t i = 0; i < chunks.size(); ++i) scanChunk(i);
+		}
+		else {
+			std::atomic<size_t> nextChunk = 0;
+			auto worker = [&]() {
+				for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++) scanChunk(i);
+			};
+
+			std::vector<std::thread> workers;
+			for (unsigned int i = 1; i < threadCount && i < chunks.size(); ++i) workers.emplace_back(worker);
+			worker();
+			for (auto& thread : workers) thread.join();
+		}
+
+		std::vector<CompleteObjectLocator**> candidates;
+		size_t candidateCount = 0;
+		for (auto& result : results) candidateCount += result.size();
+		candidates.reserve(candidateCount);
+		for (auto& result : results) candidates.insert(candidates.end(), result.begin(), result.end());
+
+		return candidates;
+	}
+
+
+	/// <summary>
+	/// Structurally validates a candidate complete object locator pointer. Does not demangle the class name, safe to call from any thread.
+	/// The candidate is expected to be immediately followed by the first entry of its virtual function table.
+	/// </summary>
+	/// <param name="pCOL">: pointer to the candidate slot in .rdata</param>
+	/// <param name="base">: executable base address</param>
+	/// <returns>true if the candidate points to a valid COL, otherwise false</returns>
+	static bool isValidCandidate(CompleteObjectLocator** pCOL, unsigned char* base, const PEParser::SectionRanges& dataRanges, const PEParser::SectionRanges& rdataRanges)
+	{
+		auto COL = *pCOL;
+		if (COL->signature != 1) return false;
+		if (!dataRanges.contains(COL->iboTypeDescriptor)) return false;
+		if (!rdataRanges.contains(COL->iboClassDescriptor)) return false;
+		ClassHierarchyDescriptor* CHD = COL->iboClassDescriptor.as<ClassHierarchyDescriptor*>(base);
+
+		return rdataRanges.contains(CHD->iboBaseClassDescriptor);
+	}
+
+	/// <summary>
+	/// Maps the RTTI of a validated candidate under its mangled class name. Must be called from a single thread.
+	/// </summary>
+	/// <param name="classes">: the class map to add the RTTI to</param>
+	/// <param name="pCOL">: pointer to the candidate slot in .rdata, validated by RTTIScanner::isValidCandidate</param>
+	/// <param name="base">: image base address</param>
+	/// <returns>true if the RTTI was mapped, otherwise false</returns>
+	static bool addCandidate(ClassIndex& classes, CompleteObjectLocator** pCOL, unsigned char* base)
+	{
+		auto COL = *pCOL;
+		TypeDescriptor* TD = COL->iboTypeDescriptor.as<TypeDescriptor*>(base);
+		ClassHierarchyDescriptor* CHD = COL->iboClassDescriptor.as<ClassHierarchyDescriptor*>(base);
+		BaseClassDescriptor* pBCD = CHD->iboBaseClassDescriptor.as< BaseClassDescriptor*>(base);
+
+		// mangled class type names have the form ".?AV...@@" (".?AU...@@" for structs)
+		size_t length = strnlen(TD->name, sizeof(TD->name));
+		if (length == sizeof(TD->name) || length < 6) return false;
+
+		std::string_view name(TD->name, length);
+		if (name.compare(0, 3, ".?A") || name.compare(length - 2, 2, "@@")) return false;
+
+		return classes.insert(name, RTTI(reinterpret_cast<void**>(pCOL + 1), COL, TD, CHD, pBCD));
+	}
+
+	enum class SIMDLevel {
+		Scalar,
+		SSE42,
+		AVX2
+	};
+
+	/// <summary>
+	/// Queries CPUID once to select the widest supported candidate filter.
+	/// AVX2 additionally requires the OS to save YMM state, which is checked through XGETBV.
+	/// </summary>
+	/// <returns>the SIMD level to use in RTTIScanner::forEachCandidate</returns>
+	static SIMDLevel getSIMDLevel()
+	{
+		static const SIMDLevel level = []() {
+			int info[4];
+			__cpuid(info, 0);
+			const int maxLeaf = info[0];
+
+			__cpuid(info, 1);
+			const bool sse42 = info[2] & (1 << 20);
+			const bool osxsave = info[2] & (1 << 27);
+			const bool avx = info[2] & (1 << 28);
+
+			bool avx2 = false;
+			if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+				__cpuidex(info, 7, 0);
+				avx2 = info[1] & (1 << 5);
+			}
+
+			return avx2 ? SIMDLevel::AVX2 : sse42 ? SIMDLevel::SSE42 : SIMDLevel::Scalar;
+		}();
+
+		return level;
+	}
+
+	/// <summary>
+	/// Calls a function for every slot that holds an .rdata pointer and is followed by a .text pointer.
+	/// Range checks are done several slots at a time in vector registers, only surviving slots reach the callback.
+	/// </summary>
+	/// <param name="slots">: the first pointer sized slot to check</param>
+	/// <param name="count">: the amount of slots to check</param>
+	/// <param name="rdataRanges">: .rdata ranges, the slot itself must point into them</param>
+	/// <param name="textRanges">: .text ranges, the slot after the checked one must point into them</param>
+	/// <param name="callback">: a function taking a void** pointer to the candidate slot</param>
+	template <typename F> static void forEachCandidate(void** slots, ptrdiff_t count, const PEParser::SectionRanges& rdataRanges, const PEParser::SectionRanges& textRanges, F&& callback)
+	{
+		ptrdiff_t i = 0;
+
+		switch (RTTIScanner::getSIMDLevel()) {
+		case SIMDLevel::AVX2:
+			i = RTTIScanner::filterAVX2(slots, count, rdataRanges, textRanges, callback);
+			break;
+		case SIMDLevel::SSE42:
+			i = RTTIScanner::filterSSE42(slots, count, rdataRanges, textRanges, callback);
+			break;
+		default:
+			break;
+		}
+
+		// the scalar loop finishes the tail left over by the vector loops
+		for (; i + 1 < count; ++i) {
+			if (rdataRanges.contains(slots[i]) && textRanges.contains(slots[i + 1])) callback(slots + i);
+		}
+	}
+
+	// Per range constants for the vector filters, with offsets rebased to absolute addresses.
+	// AVX2 and SSE4.2 only have signed 64 bit comparisons, so both sides of an unsigned comparison are biased by the sign bit.
+	struct VectorRange {
+		long long start;
+		long long biasedSize;
+	};
+
+	static std::vector<VectorRange> getVectorRanges(const PEParser::SectionRanges& ranges)
+	{
+		std::vector<VectorRange> vectorRanges;
+		for (auto& range : ranges.getRanges()) {
+			vectorRanges.push_back({ static_cast<long long>(ranges.getBase() + range.start), static_cast<long long>(range.size ^ 0x8000000000000000ull) });
+		}
+		return vectorRanges;
+	}
+
+	static __m256i inRanges256(__m256i values, const std::vector<VectorRange>& ranges)
+	{
+		const __m256i bias = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+		__m256i mask = _mm256_setzero_si256();
+		for (auto& range : ranges) {
+			__m256i offsets = _mm256_xor_si256(_mm256_sub_epi64(values, _mm256_set1_epi64x(range.start)), bias);
+			mask = _mm256_or_si256(mask, _mm256_cmpgt_epi64(_mm256_set1_epi64x(range.biasedSize), offsets));
+		}
+		return mask;
+	}
+
+	static __m128i inRanges128(__m128i values, const std::vector<VectorRange>& ranges)
+	{
+		const __m128i bias = _mm_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+		__m128i mask = _mm_setzero_si128();
+		for (auto& range : ranges) {
+			__m128i offsets = _mm_xor_si128(_mm_sub_epi64(values, _mm_set1_epi64x(range.start)), bias);
+			mask = _mm_or_si128(mask, _mm_cmpgt_epi64(_mm_set1_epi64x(range.biasedSize), offsets));
+		}
+		return mask;
+	}
+
+	// Checks 4 slots per step. Returns the index of the first slot left unchecked.
+	template <typename F> static ptrdiff_t filterAVX2(void** slots, ptrdiff_t count, const PEParser::SectionRanges& rdataRanges, const PEParser::SectionRanges& textRanges, F& callback)
+	{
+		const std::vector<VectorRange> rdata = RTTIScanner::getVectorRanges(rdataRanges);
+		const std::vector<VectorRange> text = RTTIScanner::getVectorRanges(textRanges);
+
+		ptrdiff_t i = 0;
+		for (; i + 5 <= count; i += 4) {
+			// the slot pointers and the pointers right after them, overlapping by 3 lanes
+			__m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + i));
+			__m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + i + 1));
+			__m256i mask = _mm256_and_si256(RTTIScanner::inRanges256(current, rdata), RTTIScanner::inRanges256(next, text));
+
+			unsigned long bits = static_cast<unsigned long>(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+			unsigned long lane;
+			while (_BitScanForward(&lane, bits)) {
+				callback(slots + i + lane);
+				bits &= bits - 1;
+			}
+		}
+		return i;
+	}
+
+	// Checks 2 slots per step. Returns the index of the first slot left unchecked.
+	template <typename F> static ptrdiff_t filterSSE42(void** slots, ptrdiff_t count, const PEParser::SectionRanges& rdataRanges, const PEParser::SectionRanges& textRanges, F& callback)
+	{
+		const std::vector<VectorRange> rdata = RTTIScanner::getVectorRanges(rdataRanges);
+		const std::vector<VectorRange> text = RTTIScanner::getVectorRanges(textRanges);
+
+		ptrdiff_t i = 0;
+		for (; i + 3 <= count; i += 2) {
+			__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + i));
+			__m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + i + 1));
+			__m128i mask = _mm_and_si128(RTTIScanner::inRanges128(current, rdata), RTTIScanner::inRanges128(next, text));
+
+			unsigned long bits = static_cast<unsigned long>(_mm_movemask_pd(_mm_castsi128_pd(mask)));
+			unsigned long lane;
+			while (_BitScanForward(&lane, bits)) {
+				callback(slots + i + lane);
+				bits &= bits - 1;
+			}
+		}
+		return i;
+	}
+};
+
+/// <summary>
+/// Static. A registry of class RTTI across the executable and the DLLs loaded into the process, one class map per module.
+/// Records of a module are only valid within it: offsets (ibo32) are relative to the module's own base address.
+/// The executable's classes can still be scanned with RTTIScanner, the registry scans and stores its modules separately.
+/// </summary>
+class RTTIRegistry {
+public:
+	struct Module {
+		Module(HMODULE handle, std::string name, const MODULEINFO& moduleInfo) :
+			handle(handle), name(std::move(name)), base(reinterpret_cast<unsigned char*>(moduleInfo.lpBaseOfDll)), size(moduleInfo.SizeOfImage),
+			imageInfo{}, classes(new RTTIScanner::ClassIndex()) {}
+
+		/// <summary>
+		/// Retrieves a pointer to the RTTI of a class of this module, by mangled or demangled name, see RTTIScanner::getClassRTTI.
+		/// </summary>
+		/// <param name="className">: name of the class to get RTTI of</param>
+		/// <returns>a pointer to class RTTI on success, otherwise nullptr</returns>
+		RTTIScanner::RTTI* getClassRTTI(std::string_view className) { return this->classes->find(className); }
+
+		/// <summary>
+		/// Checks if an address lies inside of the module's image.
+		/// </summary>
+		bool contains(const void* address) const noexcept
+		{
+			return static_cast<size_t>(reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(this->base)) < this->size;
+		}
+
+		/// <summary>
+		/// Constructs an integer base offset relative to the module's base address.
+		/// </summary>
+		PEParser::ibo32 getIbo32(const void* address) const noexcept { return PEParser::ibo32(address, this->base); }
+
+		HMODULE handle;
+		std::string name; // file name of the module, e.g. "eldenring.exe"
+		unsigned char* base;
+		size_t size;
+		PEParser::ImageInfo imageInfo;
+		std::shared_ptr<PEParser::SectionMap> sections;
+		std::unique_ptr<RTTIScanner::ClassIndex> classes;
+	};
+
+	/// <summary>
+	/// Enumerates the modules loaded into the process and scans every module that is not registered yet.
+	/// Modules are scanned in parallel, each on a single thread. Must not be called while holding the loader lock (e.g. from DllMain).
+	/// </summary>
+	/// <param name="threadCount">: (optional) the amount of threads to scan on, 0 by default to use all hardware threads</param>
+	/// <returns>true on success, false if the modules could not be enumerated</returns>
+	static bool scanModules(unsigned int threadCount = 0)
+	{
+		HANDLE hProcess = GetCurrentProcess();
+
+		std::vector<HMODULE> handles(256);
+		DWORD needed = 0;
+		for (;;) {
+			DWORD size = static_cast<DWORD>(handles.size() * sizeof(HMODULE));
+			if (!EnumProcessModules(hProcess, handles.data(), size, &needed)) return false;
+			if (needed <= size) break;
+			handles.resize(needed / sizeof(HMODULE));
+		}
+		handles.resize(needed / sizeof(HMODULE));
+
+		// the executable is always enumerated first, which keeps it first in the registry
+		// hold a reference to every module until it is registered, in case it is unloaded in the meantime
+		std::vector<std::unique_ptr<Module>> scanned;
+		std::vector<HMODULE> pinned;
+		for (HMODULE handle : handles) {
+			if (RTTIRegistry::isRegistered(handle)) continue;
+
+			HMODULE pin = nullptr;
+			if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCSTR>(handle), &pin)) continue;
+			pinned.push_back(pin);
+
+			std::unique_ptr<Module> module = RTTIRegistry::createModule(hProcess, handle);
+			if (module) scanned.push_back(std::move(module));
+		}
+
+		if (!threadCount) threadCount = std::thread::hardware_concurrency();
+
+		std::atomic<size_t> nextModule = 0;
+		auto worker = [&]() {
+			for (size_t i = nextModule++; i < scanned.size(); i = nextModule++) {
+				Module& module = *scanned[i];
+				RTTIScanner::scanImage(*module.classes, *module.sections, module.base);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned int i = 1; i < threadCount && i < scanned.size(); ++i) workers.emplace_back(worker);
+		worker();
+		for (auto& thread : workers) thread.join();
+
+		RTTIRegistry::registerModules(scanned);
+		for (HMODULE pin : pinned) FreeLibrary(pin);
+
+		return true;
+	}
+
+	/// <summary>
+	/// Scans a single module and registers it, unless it is already registered.
+	/// </summary>
+	/// <param name="handle">: handle of a loaded module</param>
+	/// <param name="threadCount">: (optional) the amount of threads to scan on, 1 by default (the calling thread only), 0 to use all hardware threads</param>
+	/// <returns>a pointer to the registered module on success, nullptr if the handle does not belong to a loaded PE image</returns>
+	static Module* scanModule(HMODULE handle, unsigned int threadCount = 1)
+	{
+		if (Module* module = RTTIRegistry::getModule(handle)) return module;
+
+		std::unique_ptr<Module> module = RTTIRegistry::createModule(GetCurrentProcess(), handle);
+		if (!module) return nullptr;
+
+		RTTIScanner::scanImage(*module->classes, *module->sections, module->base, threadCount);
+
+		std::vector<std::unique_ptr<Module>> scanned;
+		scanned.push_back(std::move(module));
+		RTTIRegistry::registerModules(scanned);
+
+		return RTTIRegistry::getModule(handle);
+	}
+
+	/// <summary>
+	/// Enables incremental scanning: modules loaded from now on are scanned and registered in the background by a worker thread,
+	/// modules already loaded but not yet registered are scanned first. Modules are removed from the registry when they are unloaded.
+	/// Scans do not hold the registry lock, lookups are only blocked for as long as it takes to register a scanned module.
+	/// The worker must be stopped with RTTIRegistry::disableIncrementalScan before the module is unloaded (and outside of DllMain).
+	/// </summary>
+	/// <returns>true on success, false if loader notifications are not available</returns>
+	static bool enableIncrementalScan()
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::workerMutex);
+		if (RTTIRegistry::worker.thread.joinable()) return true;
+
+		HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+		if (!ntdll) return false;
+
+		auto registerNotification = reinterpret_cast<LdrRegisterDllNotification>(GetProcAddress(ntdll, "LdrRegisterDllNotification"));
+		if (!registerNotification || registerNotification(0, &RTTIRegistry::onDllNotification, nullptr, &RTTIRegistry::worker.cookie) < 0) return false;
+
+		RTTIRegistry::worker.stopping = false;
+		RTTIRegistry::worker.scanLoaded = true;
+		RTTIRegistry::worker.thread = std::thread([]() {
+			std::unique_lock<std::mutex> lock(RTTIRegistry::workerMutex);
+			while (!RTTIRegistry::worker.stopping) {
+				if (RTTIRegistry::worker.scanLoaded) {
+					RTTIRegistry::worker.scanLoaded = false;
+					lock.unlock();
+					RTTIRegistry::scanModules(1);
+					lock.lock();
+				}
+				else if (!RTTIRegistry::worker.loaded.empty()) {
+					void* base = RTTIRegistry::worker.loaded.front();
+					RTTIRegistry::worker.loaded.erase(RTTIRegistry::worker.loaded.begin());
+					lock.unlock();
+
+					// hold a reference to the module while scanning, in case it is unloaded right after loading
+					HMODULE handle = nullptr;
+					if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCSTR>(base), &handle)) {
+						RTTIRegistry::scanModule(handle);
+						FreeLibrary(handle);
+					}
+					lock.lock();
+				}
+				else {
+					RTTIRegistry::worker.signal.wait(lock);
+				}
+			}
+		});
+
+		return true;
+	}
+
+	/// <summary>
+	/// Stops the loader notifications and the worker thread started by RTTIRegistry::enableIncrementalScan and waits for it to exit.
+	/// Registered modules are kept.
+	/// </summary>
+	static void disableIncrementalScan()
+	{
+		std::thread thread;
+		{
+			std::lock_guard<std::mutex> lock(RTTIRegistry::workerMutex);
+			if (!RTTIRegistry::worker.thread.joinable()) return;
+
+			HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+			auto unregisterNotification = ntdll ? reinterpret_cast<LdrUnregisterDllNotification>(GetProcAddress(ntdll, "LdrUnregisterDllNotification")) : nullptr;
+			if (unregisterNotification) unregisterNotification(RTTIRegistry::worker.cookie);
+			RTTIRegistry::worker.cookie = nullptr;
+
+			RTTIRegistry::worker.stopping = true;
+			RTTIRegistry::worker.loaded.clear();
+			thread = std::move(RTTIRegistry::worker.thread);
+		}
+		RTTIRegistry::worker.signal.notify_all();
+		if (thread.joinable()) thread.join();
+	}
+
+	/// <summary>
+	/// Calls a function with the RTTI of a class as soon as a module defining it is registered, or right away if one already is.
+	/// The function is called once, from the thread registering the module (the incremental scan worker for modules loaded later on).
+	/// </summary>
+	/// <param name="className">: mangled or demangled name of the class</param>
+	/// <param name="callback">: a function taking an RTTIScanner::RTTI reference</param>
+	static void onClassLoaded(std::string className, std::function<void(RTTIScanner::RTTI&)> callback)
+	{
+		RTTIScanner::RTTI* pRTTI = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+			for (auto& module : RTTIRegistry::modules) {
+				pRTTI = module->getClassRTTI(className);
+				if (pRTTI) break;
+			}
+
+			if (!pRTTI) {
+				RTTIRegistry::pending.push_back({ std::move(className), std::move(callback) });
+				return;
+			}
+		}
+
+		callback(*pRTTI);
+	}
+
+	/// <summary>
+	/// Retrieves a registered module by its file name, case insensitive ("eldenring.exe").
+	/// </summary>
+	/// <returns>a pointer to the module on success, otherwise nullptr. The pointer stays valid until the registry is destroyed</returns>
+	static Module* getModule(std::string_view moduleName)
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+		for (auto& module : RTTIRegistry::modules) {
+			if (RTTIRegistry::equalsIgnoreCase(module->name, moduleName)) return module.get();
+		}
+
+		return nullptr;
+	}
+
+	/// <summary>
+	/// Retrieves the registered module containing an address, e.g. that of a virtual function table.
+	/// </summary>
+	/// <returns>a pointer to the module on success, otherwise nullptr. The pointer stays valid until the registry is destroyed</returns>
+	static Module* getModuleContaining(const void* address)
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+		for (auto& module : RTTIRegistry::modules) {
+			if (module->contains(address)) return module.get();
+		}
+
+		return nullptr;
+	}
+
+	/// <summary>
+	/// Retrieves a registered module by its handle.
+	/// </summary>
+	/// <returns>a pointer to the module on success, otherwise nullptr. The pointer stays valid until the registry is destroyed</returns>
+	static Module* getModule(HMODULE handle)
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+		return RTTIRegistry::findModule(handle);
+	}
+
+	/// <summary>
+	/// Calls a function for every registered module, the executable first and the rest in load order.
+	/// The registry is locked for the duration of the call, the function must not register or remove modules.
+	/// </summary>
+	/// <param name="function">: a function taking an RTTIRegistry::Module reference</param>
+	template <typename F> static void forEachModule(F&& function)
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+		for (auto& module : RTTIRegistry::modules) function(*module);
+	}
+
+	/// <summary>
+	/// Retrieves a pointer to the RTTI of a class by name from any registered module.
+	/// The executable is searched first, the first match in load order is returned for classes defined in several modules.
+	/// </summary>
+	/// <param name="className">: mangled or demangled name of the class to get RTTI of</param>
+	/// <returns>a pointer to class RTTI on success, otherwise nullptr. The pointer stays valid until the registry is destroyed</returns>
+	static RTTIScanner::RTTI* getClassRTTI(std::string_view className)
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+		for (auto& module : RTTIRegistry::modules) {
+			if (RTTIScanner::RTTI* pRTTI = module->getClassRTTI(className)) return pRTTI;
+		}
+
+		return nullptr;
+	}
+
+	/// <summary>
+	/// Retrieves a pointer to the RTTI of a class by name from a specific module.
+	/// </summary>
+	/// <param name="moduleName">: file name of the module, case insensitive</param>
+	/// <param name="className">: mangled or demangled name of the class to get RTTI of</param>
+	/// <returns>a pointer to class RTTI on success, otherwise nullptr. The pointer stays valid until the registry is destroyed</returns>
+	static RTTIScanner::RTTI* getClassRTTI(std::string_view moduleName, std::string_view className)
+	{
+		Module* module = RTTIRegistry::getModule(moduleName);
+		return module ? module->getClassRTTI(className) : nullptr;
+	}
+
+	/// <summary>
+	/// Removes a module from the registry, e.g. before it is unloaded. The module record is kept until the registry is destroyed,
+	/// pointers to it stay valid, but once the module is unloaded its RTTI points into memory which is no longer mapped.
+	/// </summary>
+	/// <returns>true if the module was registered, otherwise false</returns>
+	static bool removeModule(HMODULE handle)
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+		auto iter = std::find_if(RTTIRegistry::modules.begin(), RTTIRegistry::modules.end(), [handle](auto& module) { return module->handle == handle; });
+		if (iter == RTTIRegistry::modules.end()) return false;
+
+		RTTIRegistry::retiredModules.push_back(std::move(*iter));
+		RTTIRegistry::modules.erase(iter);
+		return true;
+	}
+
+	/// <summary>
+	/// Removes all modules from the registry, see RTTIRegistry::removeModule.
+	/// </summary>
+	static void clear()
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+		for (auto& module : RTTIRegistry::modules) RTTIRegistry::retiredModules.push_back(std::move(module));
+		RTTIRegistry::modules.clear();
+	}
+
+private:
+	// The loader notification data, identical for loaded and unloaded modules.
+	struct DllNotificationData {
+		ULONG flags;
+		const void* fullDllName;
+		const void* baseDllName;
+		void* dllBase;
+		ULONG sizeOfImage;
+	};
+
+	typedef void (CALLBACK* DllNotificationFunction)(ULONG reason, const DllNotificationData* data, void* context);
+	typedef LONG (NTAPI* LdrRegisterDllNotification)(ULONG flags, DllNotificationFunction function, void* context, void** cookie);
+	typedef LONG (NTAPI* LdrUnregisterDllNotification)(void* cookie);
+
+	static constexpr ULONG dllNotificationLoaded = 1;
+	static constexpr ULONG dllNotificationUnloaded = 2;
+
+	// A class lookup waiting for a module defining the class, see RTTIRegistry::onClassLoaded.
+	struct Pending {
+		std::string className;
+		std::function<void(RTTIScanner::RTTI&)> callback;
+	};
+
+	// A worker thread still running at exit is told to stop and left behind, joining it during module unload would deadlock.
+	struct Worker {
+		Worker() : cookie(nullptr), stopping(false), scanLoaded(false) {}
+
+		~Worker()
+		{
+			if (!this->thread.joinable()) return;
+
+			{
+				std::lock_guard<std::mutex> lock(RTTIRegistry::workerMutex);
+				this->stopping = true;
+			}
+			this->signal.notify_all();
+			this->thread.detach();
+		}
+
+		std::thread thread;
+		std::condition_variable signal;
+		std::vector<void*> loaded; // base addresses of loaded modules waiting to be scanned
+		void* cookie;
+		bool stopping;
+		bool scanLoaded;
+	};
+
+	// Called by the loader with the loader lock held, only queues work and unregisters modules.
+	static void CALLBACK onDllNotification(ULONG reason, const DllNotificationData* data, void*)
+	{
+		if (reason == RTTIRegistry::dllNotificationLoaded) {
+			{
+				std::lock_guard<std::mutex> lock(RTTIRegistry::workerMutex);
+				RTTIRegistry::worker.loaded.push_back(data->dllBase);
+			}
+			RTTIRegistry::worker.signal.notify_all();
+		}
+		else if (reason == RTTIRegistry::dllNotificationUnloaded) {
+			{
+				std::lock_guard<std::mutex> lock(RTTIRegistry::workerMutex);
+				auto& loaded = RTTIRegistry::worker.loaded;
+				loaded.erase(std::remove(loaded.begin(), loaded.end(), data->dllBase), loaded.end());
+			}
+			RTTIRegistry::removeModule(reinterpret_cast<HMODULE>(data->dllBase));
+		}
+	}
+
+	/// <summary>
+	/// Registers scanned modules and runs the callbacks of pending lookups for classes they define.
+	/// Another thread may have registered the same module in the meantime, the first registration is kept.
+	/// </summary>
+	static void registerModules(std::vector<std::unique_ptr<Module>>& scanned)
+	{
+		std::vector<std::pair<std::function<void(RTTIScanner::RTTI&)>, RTTIScanner::RTTI*>> ready;
+		{
+			std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+			for (auto& module : scanned) {
+				if (RTTIRegistry::findModule(module->handle)) continue;
+
+				auto& pending = RTTIRegistry::pending;
+				for (auto iter = pending.begin(); iter != pending.end();) {
+					if (RTTIScanner::RTTI* pRTTI = module->getClassRTTI(iter->className)) {
+						ready.emplace_back(std::move(iter->callback), pRTTI);
+						iter = pending.erase(iter);
+					}
+					else {
+						++iter;
+					}
+				}
+
+				RTTIRegistry::modules.push_back(std::move(module));
+			}
+		}
+
+		// callbacks run without the lock, they may look up classes or place hooks
+		for (auto& [callback, pRTTI] : ready) callback(*pRTTI);
+	}
+
+	static std::unique_ptr<Module> createModule(HANDLE hProcess, HMODULE handle)
+	{
+		MODULEINFO moduleInfo{};
+		if (!GetModuleInformation(hProcess, handle, &moduleInfo, sizeof(moduleInfo))) return nullptr;
+
+		char modulePath[MAX_PATH];
+		DWORD length = GetModuleFileNameA(handle, modulePath, sizeof(modulePath));
+		if (!length || length == sizeof(modulePath)) return nullptr;
+
+		std::string_view path(modulePath, length);
+		size_t separator = path.find_last_of("\\/");
+		if (separator != std::string_view::npos) path.remove_prefix(separator + 1);
+
+		std::unique_ptr<Module> module(new Module(handle, std::string(path), moduleInfo));
+		module->sections = PEParser::parseImage(module->base, &module->imageInfo);
+		if (!module->sections) return nullptr;
+
+		return module;
+	}
+
+	static bool isRegistered(HMODULE handle)
+	{
+		std::lock_guard<std::mutex> lock(RTTIRegistry::mutex);
+
+		return RTTIRegistry::findModule(handle);
+	}
+
+	// Must be called with mutex held.
+	static Module* findModule(HMODULE handle)
+	{
+		for (auto& module : RTTIRegistry::modules) {
+			if (module->handle == handle) return module.get();
+		}
+
+		return nullptr;
+	}
+
+	static bool equalsIgnoreCase(std::string_view a, std::string_view b) noexcept
+	{
+		if (a.size() != b.size()) return false;
+
+		for (size_t i = 0; i < a.size(); ++i) {
+			char ca = a[i] >= 'A' && a[i] <= 'Z' ? a[i] - 'A' + 'a' : a[i];
+			char cb = b[i] >= 'A' && b[i] <= 'Z' ? b[i] - 'A' + 'a' : b[i];
+			if (ca != cb) return false;
+		}
+
+		return true;
+	}
+
+	static inline std::mutex mutex{};
+	static inline std::vector<std::unique_ptr<Module>> modules{};
+	// Removed modules are kept until the registry is destroyed, so that pointers returned before the removal stay valid,
+	// e.g. while a module is unloaded by the loader in the middle of a lookup on another thread.
+	static inline std::vector<std::unique_ptr<Module>> retiredModules{};
+	static inline std::vector<Pending> pending{};
+
+	static inline std::mutex workerMutex{};
+	static inline Worker worker{};
+};
+
+/// <summary>
+/// Exports a whole class map with its hierarchy and virtual function tables, e.g. of the build a crash happened in.
+/// The records are streamed from the class map to the file through a fixed size buffer, nothing is built in memory per record.
+/// The binary format is columnar and meant to be memory mapped by other tools, the JSON format is for reading and scripting.
+/// Both are written under a temporary name and moved into place once complete.
+/// Function counts are the amount of consecutive pointers into .text at the start of a table, up to the next table.
+/// </summary>
+class RTTIExporter {
+public:
+	/// <summary>
+	/// The binary export starts with this header, followed by a directory of columnCount Column structs.
+	/// Every column is an array of count elements of elementSize bytes at offset from the start of the file, aligned to 8 bytes.
+	/// Columns are identified by name, unknown columns are to be skipped:
+	/// - "class.name" (u32, classes + 1): offsets of the mangled class names in "names", each name is null terminated;
+	/// - "class.td", "class.col", "class.vft" (i32, classes): ibo32s of the type descriptor, complete object locator and primary table;
+	/// - "class.functions" (u32, classes): the function count of the primary table;
+	/// - "class.bases" (u32, classes + 1): the range of a class's rows in the base columns, in base class array order;
+	/// - "base.class" (u32, bases): the class id of a base, ~0 if it has no virtual function table of its own;
+	/// - "base.contained", "base.attributes" (u32, bases) and "base.mdisp", "base.pdisp", "base.vdisp" (i32, bases): see RTTIScanner::BaseClass;
+	/// - "table.vft" (i32, tables), "table.class", "table.offset", "table.functions" (u32, tables): every table in address order,
+	///   its complete class, the offset of the subobject using it and its function count;
+	/// - "table.slots" (u32, tables + 1): the range of a table's rows in "slot.fingerprint";
+	/// - "slot.fingerprint" (u32, slots): the fingerprint of every function of every table, see RTTIScanner::ClassIndex::getFingerprints;
+	/// - "names" (char, bytes): the name buffer.
+	/// Class ids are row indices of the class columns.
+	/// </summary>
+	struct BinaryHeader {
+		char magic[8];
+		unsigned int version;
+		unsigned int timeDateStamp;
+		unsigned int checkSum;
+		unsigned int sizeOfImage;
+		unsigned int classCount;
+		unsigned int baseCount;
+		unsigned int tableCount;
+		unsigned int columnCount;
+	};
+
+	struct Column {
+		char name[16];
+		unsigned int elementSize;
+		unsigned int reserved;
+		unsigned long long offset;
+		unsigned long long count;
+	};
+
+	static constexpr char binaryMagic[8] = { 'R', 'T', 'T', 'I', 'D', 'u', 'm', 'p' };
+	static constexpr unsigned int binaryVersion = 1;
+
+	/// <summary>
+	/// Static. Exports the class map of the last scan in the binary format, see RTTIExporter::BinaryHeader.
+	/// </summary>
+	/// <param name="path">: path to the export file, replaced if it exists</param>
+	/// <returns>true on success, false if no scan has completed or the file could not be written</returns>
+	static bool exportBinary(const std::string& path)
+	{
+		RTTIScanner::ClassIndex* classes = RTTIScanner::getClassIndex();
+		return classes && RTTIExporter::exportBinary(path, *classes);
+	}
+
+	/// <summary>
+	/// Static. Exports a class map in the binary format, see RTTIExporter::BinaryHeader.
+	/// </summary>
+	/// <param name="path">: path to the export file, replaced if it exists</param>
+	/// <param name="classes">: a class map, e.g. of a module of RTTIRegistry. Its image must still be mapped</param>
+	/// <returns>true on success, false if the image headers cannot be parsed or the file could not be written</returns>
+	static bool exportBinary(const std::string& path, const RTTIScanner::ClassIndex& classes)
+	{
+		Image image(classes);
+		if (!image) return false;
+
+		const unsigned int classCount = static_cast<unsigned int>(classes.size());
+		unsigned int baseCount = 0;
+		unsigned int tableCount = 0;
+		size_t namesSize = 0;
+		for (unsigned int i = 0; i < classCount; ++i) {
+			const RTTIScanner::RTTI& rtti = *classes.getClass(i);
+			namesSize += rtti.getMangledName().size() + 1;
+			classes.forEachBaseClass(rtti, [&baseCount](const RTTIScanner::BaseClass&) { ++baseCount; });
+		}
+		unsigned int slotCount = 0;
+		classes.forEachVirtualFunctionTable([&](void**, RTTIScanner::RTTI&, unsigned int, unsigned int functionCount) {
+			++tableCount;
+			slotCount += functionCount;
+		});
+
+		// the layout is known up front, the columns are streamed one after another
+		struct ColumnSize {
+			const char* name;
+			unsigned int elementSize;
+			unsigned long long count;
+		};
+		const ColumnSize columnSizes[] = {
+			{ "class.name", 4, classCount + 1ull }, { "class.td", 4, classCount }, { "class.col", 4, classCount }, { "class.vft", 4, classCount },
+			{ "class.functions", 4, classCount }, { "class.bases", 4, classCount + 1ull },
+			{ "base.class", 4, baseCount }, { "base.contained", 4, baseCount }, { "base.mdisp", 4, baseCount }, { "base.pdisp", 4, baseCount },
+			{ "base.vdisp", 4, baseCount }, { "base.attributes", 4, baseCount },
+			{ "table.vft", 4, tableCount }, { "table.class", 4, tableCount }, { "table.offset", 4, tableCount }, { "table.functions", 4, tableCount },
+			{ "table.slots", 4, tableCount + 1ull }, { "slot.fingerprint", 4, slotCount },
+			{ "names", 1, namesSize },
+		};
+		constexpr unsigned int columnCount = sizeof(columnSizes) / sizeof(ColumnSize);
+
+		Output output(path);
+		if (!output) return false;
+
+		BinaryHeader header{};
+		memcpy(header.magic, RTTIExporter::binaryMagic, sizeof(header.magic));
+		header.version = RTTIExporter::binaryVersion;
+		header.timeDateStamp = image.info.timeDateStamp;
+		header.checkSum = image.info.checkSum;
+		header.sizeOfImage = image.info.sizeOfImage;
+		header.classCount = classCount;
+		header.baseCount = baseCount;
+		header.tableCount = tableCount;
+		header.columnCount = columnCount;
+		output.writeValue(header);
+
+		unsigned long long offset = RTTIExporter::align(sizeof(BinaryHeader) + columnCount * sizeof(Column));
+		for (const ColumnSize& size : columnSizes) {
+			Column column{};
+			strncpy(column.name, size.name, sizeof(column.name) - 1);
+			column.elementSize = size.elementSize;
+			column.offset = offset;
+			column.count = size.count;
+			output.writeValue(column);
+			offset = RTTIExporter::align(offset + size.count * size.elementSize);
+		}
+		output.pad();
+
+		auto forEachClass = [&](auto&& function) {
+			for (unsigned int i = 0; i < classCount; ++i) function(*classes.getClass(i));
+		};
+		auto forEachBase = [&](auto&& function) {
+			forEachClass([&](const RTTIScanner::RTTI& rtti) { classes.forEachBaseClass(rtti, function); });
+		};
+
+		unsigned int nameOffset = 0;
+		forEachClass([&](const RTTIScanner::RTTI& rtti) {
+			output.writeValue(nameOffset);
+			nameOffset += static_cast<unsigned int>(rtti.getMangledName().size() + 1);
+		});
+		output.writeValue(nameOffset);
+		output.pad();
+		forEachClass([&](const RTTIScanner::RTTI& rtti) { output.writeValue(image.getIbo32(rtti.pTypeDescriptor)); });
+		output.pad();
+		forEachClass([&](const RTTIScanner::RTTI& rtti) { output.writeValue(image.getIbo32(rtti.pCompleteObjectLocator)); });
+		output.pad();
+		forEachClass([&](const RTTIScanner::RTTI& rtti) { output.writeValue(image.getIbo32(rtti.pVirtualFunctionTable)); });
+		output.pad();
+
+		forEachClass([&](const RTTIScanner::RTTI& rtti) { output.writeValue(rtti.functionCount); });
+		output.pad();
+
+		unsigned int baseIndex = 0;
+		forEachClass([&](const RTTIScanner::RTTI& rtti) {
+			output.writeValue(baseIndex);
+			classes.forEachBaseClass(rtti, [&baseIndex](const RTTIScanner::BaseClass&) { ++baseIndex; });
+		});
+		output.writeValue(baseIndex);
+		output.pad();
+
+		forEachBase([&](const RTTIScanner::BaseClass& base) { output.writeValue(base.classId); });
+		output.pad();
+		forEachBase([&](const RTTIScanner::BaseClass& base) { output.writeValue(base.numContainedBases); });
+		output.pad();
+		forEachBase([&](const RTTIScanner::BaseClass& base) { output.writeValue(base.mdisp); });
+		output.pad();
+		forEachBase([&](const RTTIScanner::BaseClass& base) { output.writeValue(base.pdisp); });
+		output.pad();
+		forEachBase([&](const RTTIScanner::BaseClass& base) { output.writeValue(base.vdisp); });
+		output.pad();
+		forEachBase([&](const RTTIScanner::BaseClass& base) { output.writeValue(base.attributes); });
+		output.pad();
+
+		classes.forEachVirtualFunctionTable([&](void** pVirtualFunctionTable, RTTIScanner::RTTI&, unsigned int, unsigned int) { output.writeValue(image.getIbo32(pVirtualFunctionTable)); });
+		output.pad();
+		classes.forEachVirtualFunctionTable([&](void**, RTTIScanner::RTTI& rtti, unsigned int, unsigned int) { output.writeValue(rtti.classId); });
+		output.pad();
+		classes.forEachVirtualFunctionTable([&](void**, RTTIScanner::RTTI&, unsigned int subobjectOffset, unsigned int) { output.writeValue(subobjectOffset); });
+		output.pad();
+		classes.forEachVirtualFunctionTable([&](void**, RTTIScanner::RTTI&, unsigned int, unsigned int functionCount) { output.writeValue(functionCount); });
+		output.pad();
+
+		unsigned int slotIndex = 0;
+		classes.forEachVirtualFunctionTable([&](void**, RTTIScanner::RTTI&, unsigned int, unsigned int functionCount) {
+			output.writeValue(slotIndex);
+			slotIndex += functionCount;
+		});
+		output.writeValue(slotIndex);
+		output.pad();
+		classes.forEachVirtualFunctionTable([&](void** pVirtualFunctionTable, RTTIScanner::RTTI&, unsigned int, unsigned int functionCount) {
+			output.write(classes.getFingerprints(pVirtualFunctionTable), functionCount * sizeof(unsigned int));
+		});
+		output.pad();
+
+		forEachClass([&](const RTTIScanner::RTTI& rtti) {
+			std::string_view name = rtti.getMangledName();
+			output.write(name.data(), name.size());
+			output.writeValue('\0');
+		});
+		output.pad();
+
+		return output.commit();
+	}
+
+	/// <summary>
+	/// Static. Exports the class map of the last scan as JSON, see RTTIExporter::exportJSON.
+	/// </summary>
+	/// <param name="path">: path to the export file, replaced if it exists</param>
+	/// <param name="demangle">: (optional) add the demangled name of every class, which demangles every class that was not demangled yet</param>
+	/// <returns>true on success, false if no scan has completed or the file could not be written</returns>
+	static bool exportJSON(const std::string& path, bool demangle = false)
+	{
+		RTTIScanner::ClassIndex* classes = RTTIScanner::getClassIndex();
+		return classes && RTTIExporter::exportJSON(path, *classes, demangle);
+	}
+
+	/// <summary>
+	/// Static. Exports a class map as a single JSON object, written while it is generated:
+	/// {"image":{"timeDateStamp","checkSum","sizeOfImage"},
+	///  "classes":[{"id","name","demangledName"(optional),"typeDescriptor","completeObjectLocator","vft","functions",
+	///              "bases":[{"id"(null without a table of its own),"name","contained","mdisp","pdisp","vdisp","attributes"}]}],
+	///  "tables":[{"vft","class","offset","functions","fingerprints":[]}]}
+	/// Addresses are ibo32s, names are mangled unless demangled names are requested.
+	/// </summary>
+	/// <param name="path">: path to the export file, replaced if it exists</param>
+	/// <param name="classes">: a class map, e.g. of a module of RTTIRegistry. Its image must still be mapped</param>
+	/// <param name="demangle">: (optional) add the demangled name of every class, which demangles every class that was not demangled yet</param>
+	/// <returns>true on success, false if the image headers cannot be parsed or the file could not be written</returns>
+	static bool exportJSON(const std::string& path, const RTTIScanner::ClassIndex& classes, bool demangle = false)
+	{
+		Image image(classes);
+		if (!image) return false;
+
+		Output output(path);
+		if (!output) return false;
+
+		output.write("{\"image\":{\"timeDateStamp\":");
+		output.writeNumber(image.info.timeDateStamp);
+		output.write(",\"checkSum\":");
+		output.writeNumber(image.info.checkSum);
+		output.write(",\"sizeOfImage\":");
+		output.writeNumber(image.info.sizeOfImage);
+		output.write("},\n\"classes\":[");
+
+		for (unsigned int i = 0; i < classes.size(); ++i) {
+			RTTIScanner::RTTI& rtti = *classes.getClass(i);
+
+			output.write(i ? ",\n{\"id\":" : "\n{\"id\":");
+			output.writeNumber(i);
+			output.write(",\"name\":");
+			output.writeString(rtti.getMangledName());
+			if (demangle) {
+				output.write(",\"demangledName\":");
+				output.writeString(rtti.getName());
+			}
+			output.write(",\"typeDescriptor\":");
+			output.writeNumber(image.getIbo32(rtti.pTypeDescriptor));
+			output.write(",\"completeObjectLocator\":");
+			output.writeNumber(image.getIbo32(rtti.pCompleteObjectLocator));
+			output.write(",\"vft\":");
+			output.writeNumber(image.getIbo32(rtti.pVirtualFunctionTable));
+			output.write(",\"functions\":");
+			output.writeNumber(rtti.functionCount);
+			output.write(",\"bases\":[");
+
+			bool first = true;
+			classes.forEachBaseClass(rtti, [&](const RTTIScanner::BaseClass& base) {
+				output.write(first ? "{\"id\":" : ",{\"id\":");
+				first = false;
+				if (base.classId == RTTIScanner::BaseClass::noClass) output.write("null");
+				else output.writeNumber(base.classId);
+				output.write(",\"name\":");
+				output.writeString(base.pTypeDescriptor->name);
+				output.write(",\"contained\":");
+				output.writeNumber(base.numContainedBases);
+				output.write(",\"mdisp\":");
+				output.writeNumber(base.mdisp);
+				output.write(",\"pdisp\":");
+				output.writeNumber(base.pdisp);
+				output.write(",\"vdisp\":");
+				output.writeNumber(base.vdisp);
+				output.write(",\"attributes\":");
+				output.writeNumber(base.attributes);
+				output.write("}");
+			});
+			output.write("]}");
+		}
+
+		output.write("],\n\"tables\":[");
+		bool first = true;
+		classes.forEachVirtualFunctionTable([&](void** pVirtualFunctionTable, RTTIScanner::RTTI& rtti, unsigned int subobjectOffset, unsigned int functionCount) {
+			output.write(first ? "\n{\"vft\":" : ",\n{\"vft\":");
+			first = false;
+			output.writeNumber(image.getIbo32(pVirtualFunctionTable));
+			output.write(",\"class\":");
+			output.writeNumber(rtti.classId);
+			output.write(",\"offset\":");
+			output.writeNumber(subobjectOffset);
+			output.write(",\"functions\":");
+			output.writeNumber(functionCount);
+			output.write(",\"fingerprints\":[");
+			const unsigned int* fingerprints = classes.getFingerprints(pVirtualFunctionTable);
+			for (unsigned int i = 0; i < functionCount; ++i) {
+				if (i) output.writeValue(',');
+				output.writeNumber(fingerprints[i]);
+			}
+			output.write("]}");
+		});
+		output.write("]}\n");
+
+		return output.commit();
+	}
+
+private:
+	// The image of a class map and its identifying header fields.
+	struct Image {
+		Image(const RTTIScanner::ClassIndex& classes) : base(reinterpret_cast<unsigned char*>(classes.getImageBase()))
+		{
+			if (this->base) this->sections = PEParser::parseImage(this->base, &this->info);
+		}
+
+		explicit operator bool() const { return !!this->sections; }
+
+		int getIbo32(const void* address) const { return PEParser::ibo32(address, this->base).as(); }
+
+		unsigned char* base;
+		PEParser::ImageInfo info{};
+		std::shared_ptr<PEParser::SectionMap> sections;
+	};
+
+	// Buffers writes to a temporary file, which replaces the destination file once committed and is deleted otherwise.
+	class Output {
+	public:
+		Output(const std::string& path) : path(path), tempPath(path + "." + std::to_string(GetCurrentProcessId()) + ".tmp"), file(tempPath, std::ios::binary | std::ios::trunc) {}
+
+		~Output()
+		{
+			if (this->committed) return;
+			this->file.close();
+			DeleteFileA(this->tempPath.c_str());
+		}
+
+		explicit operator bool() const { return !!this->file; }
+
+		void write(const void* data, size_t size)
+		{
+			if (this->used + size > Output::bufferSize) this->flush();
+			if (size > Output::bufferSize) {
+				this->file.write(reinterpret_cast<const char*>(data), size);
+				this->written += size;
+				return;
+			}
+			memcpy(this->buffer.get() + this->used, data, size);
+			this->used += size;
+		}
+
+		template <typename T> void writeValue(const T& value) { this->write(&value, sizeof(T)); }
+
+		void write(std::string_view text) { this->write(text.data(), text.size()); }
+		void write(const char* text) { this->write(std::string_view(text)); }
+
+		template <typename T> void writeNumber(T value)
+		{
+			char digits[24];
+			auto result = std::to_chars(digits, digits + sizeof(digits), value);
+			this->write(digits, result.ptr - digits);
+		}
+
+		// Writes a JSON string, escaping quotes, backslashes and control characters.
+		void writeString(std::string_view text)
+		{
+			this->writeValue('"');
+			size_t start = 0;
+			for (size_t i = 0; i < text.size(); ++i) {
+				const unsigned char c = static_cast<unsigned char>(text[i]);
+				if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+				this->write(text.data() + start, i - start);
+				char escape[7] = { '\\', static_cast<char>(c), 0 };
+				if (c < 0x20) snprintf(escape, sizeof(escape), "\\u%04X", c);
+				this->write(escape);
+				start = i + 1;
+			}
+			this->write(text.data() + start, text.size() - start);
+			this->writeValue('"');
+		}
+
+		// Pads the file to the alignment of the binary columns.
+		void pad()
+		{
+			static constexpr char zeros[8]{};
+			const size_t position = this->written + this->used;
+			this->write(zeros, RTTIExporter::align(position) - position);
+		}
+
+		bool commit()
+		{
+			this->flush();
+			this->file.close();
+			if (!this->file) return false;
+
+			if (!MoveFileExA(this->tempPath.c_str(), this->path.c_str(), MOVEFILE_REPLACE_EXISTING)) return false;
+			this->committed = true;
+			return true;
+		}
+
+	private:
+		void flush()
+		{
+			this->file.write(this->buffer.get(), this->used);
+			this->written += this->used;
+			this->used = 0;
+		}
+
+		std::string path;
+		std::string tempPath;
+		std::ofstream file;
+		// on the heap, exporting may run on threads with small stacks
+		static constexpr size_t bufferSize = 0x10000;
+		std::unique_ptr<char[]> buffer{ new char[Output::bufferSize] };
+		size_t used = 0;
+		size_t written = 0;
+		bool committed = false;
+	};
+
+	static unsigned long long align(unsigned long long offset) { return (offset + 7) & ~7ull; }
 };
@@ -1,10 +1,1360 @@
 #pragma once
 
 #include <mutex>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <type_traits>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include <cstddef>
+#include <intrin.h>
 #include <immintrin.h>
 
 #include "RTTIScanner.h"
 #include "HookTemplates.h"
+#include <tlhelp32.h>
+
+/// <summary>
+/// A slab allocator for hook instances.
+/// Hooks are carved out of shared executable regions instead of reserving a whole allocation granularity region for each,
+/// which packs the stubs together for instruction cache and TLB locality.
+/// Every region holds slots of a single size, rounded up to a cache line.
+/// </summary>
+class HookAllocator {
+public:
+	/// <summary>
+	/// Allocates executable memory for a hook instance.
+	/// </summary>
+	/// <param name="size">: size of the hook instance in bytes</param>
+	/// <returns>a pointer to cache line aligned executable memory on success, otherwise nullptr</returns>
+	static void* allocate(size_t size)
+	{
+		const size_t slotSize = (size + HookAllocator::slotAlignment - 1) & ~(HookAllocator::slotAlignment - 1);
+		if (!slotSize || slotSize > HookAllocator::regionSize) return nullptr;
+
+		std::lock_guard<std::mutex> lock(HookAllocator::mutex);
+
+		return HookAllocator::allocateSlot(slotSize);
+	}
+
+	/// <summary>
+	/// Allocates executable memory for a number of hook instances of the same size at once, under a single lock.
+	/// Consecutive slots are carved from the same region until it is full, keeping the instances next to each other.
+	/// </summary>
+	/// <param name="size">: size of a hook instance in bytes</param>
+	/// <param name="count">: the amount of hook instances</param>
+	/// <param name="slots">: receives a pointer to cache line aligned executable memory for each instance</param>
+	/// <returns>the amount of slots allocated, less than count if memory ran out</returns>
+	static size_t allocate(size_t size, size_t count, void** slots)
+	{
+		const size_t slotSize = (size + HookAllocator::slotAlignment - 1) & ~(HookAllocator::slotAlignment - 1);
+		if (!slotSize || slotSize > HookAllocator::regionSize) return 0;
+
+		std::lock_guard<std::mutex> lock(HookAllocator::mutex);
+
+		for (size_t i = 0; i < count; ++i) {
+			slots[i] = HookAllocator::allocateSlot(slotSize);
+			if (!slots[i]) return i;
+		}
+		return count;
+	}
+
+	/// <summary>
+	/// Returns a hook instance's memory to its region. Regions are released once empty, unless they are the last of their slot size.
+	/// </summary>
+	/// <param name="slot">: a pointer returned by HookAllocator::allocate</param>
+	static void free(void* slot)
+	{
+		if (!slot) return;
+
+		std::lock_guard<std::mutex> lock(HookAllocator::mutex);
+
+		// regions are allocation granularity aligned, the region base is found by masking
+		const uintptr_t regionBase = reinterpret_cast<uintptr_t>(slot) & ~(HookAllocator::regionSize - 1);
+		auto iter = HookAllocator::regions.find(regionBase);
+		if (iter == HookAllocator::regions.end()) return;
+
+		Region& region = iter->second;
+		*reinterpret_cast<void**>(slot) = region.freeList;
+		region.freeList = slot;
+
+		if (--region.used) return;
+
+		auto& sizeClass = HookAllocator::sizeClasses[region.slotSize];
+		if (sizeClass.size() <= 1) return;
+
+		for (auto classIter = sizeClass.begin(); classIter != sizeClass.end(); ++classIter) {
+			if (*classIter == regionBase) {
+				sizeClass.erase(classIter);
+				break;
+			}
+		}
+		HookAllocator::regions.erase(iter);
+		VirtualFree(reinterpret_cast<void*>(regionBase), NULL, MEM_RELEASE);
+	}
+
+	/// <summary>
+	/// Gets the size of the slot holding a hook instance.
+	/// </summary>
+	/// <param name="slot">: a pointer returned by HookAllocator::allocate</param>
+	/// <returns>the slot size in bytes, 0 if the pointer was not allocated by HookAllocator</returns>
+	static size_t getSlotSize(const void* slot)
+	{
+		std::lock_guard<std::mutex> lock(HookAllocator::mutex);
+
+		auto iter = HookAllocator::regions.find(reinterpret_cast<uintptr_t>(slot) & ~(HookAllocator::regionSize - 1));
+		return iter != HookAllocator::regions.end() ? iter->second.slotSize : 0;
+	}
+
+private:
+	static constexpr size_t regionSize = 0x10000; // the allocation granularity on x86-64 Windows
+	static constexpr size_t slotAlignment = 64; // a cache line
+
+	struct Region {
+		size_t slotSize = 0;
+		size_t used = 0; // slots currently handed out
+		size_t carved = 0; // slots handed out at least once, slots past this one have never been used
+		void* freeList = nullptr; // intrusive list of returned slots
+	};
+
+	// Must be called with mutex held.
+	static void* allocateSlot(size_t slotSize)
+	{
+		auto& sizeClass = HookAllocator::sizeClasses[slotSize];
+		for (uintptr_t regionBase : sizeClass) {
+			Region& region = HookAllocator::regions[regionBase];
+			if (void* slot = HookAllocator::takeSlot(regionBase, region)) return slot;
+		}
+
+		// all regions of this slot size are full
+		void* regionBase = VirtualAlloc(nullptr, HookAllocator::regionSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+		if (!regionBase) return nullptr;
+
+		sizeClass.push_back(reinterpret_cast<uintptr_t>(regionBase));
+		Region& region = HookAllocator::regions[reinterpret_cast<uintptr_t>(regionBase)];
+		region.slotSize = slotSize;
+
+		return HookAllocator::takeSlot(reinterpret_cast<uintptr_t>(regionBase), region);
+	}
+
+	static void* takeSlot(uintptr_t regionBase, Region& region)
+	{
+		void* slot = nullptr;
+
+		if (region.freeList) {
+			slot = region.freeList;
+			region.freeList = *reinterpret_cast<void**>(slot);
+		}
+		else if ((region.carved + 1) * region.slotSize <= HookAllocator::regionSize) {
+			slot = reinterpret_cast<void*>(regionBase + region.carved++ * region.slotSize);
+		}
+		else {
+			return nullptr;
+		}
+
+		++region.used;
+		return slot;
+	}
+
+	static inline std::mutex mutex{};
+	static inline std::unordered_map<uintptr_t, Region> regions{};
+	static inline std::unordered_map<size_t, std::vector<uintptr_t>> sizeClasses{}; // region bases by slot size
+};
+
+/// <summary>
+/// Process-wide, reference counted page protection changes for writes to potentially read-only memory.
+/// The first thread to open a page makes it writable and the last one to close it restores its original protection,
+/// so a thread restoring a page can never make it read-only under another thread's write.
+/// Used by HookChain, VFTHookBatch and VFTHookTemplate::rdataWrite.
+/// </summary>
+class PageProtection {
+public:
+	static constexpr uintptr_t pageSize = 0x1000;
+
+	/// <summary>
+	/// Static. Makes the pages of a pointer writable until they are closed with PageProtection::close.
+	/// </summary>
+	/// <param name="pAddress">: a pointer to the address in memory to be written to</param>
+	/// <returns>true if the memory is writable, otherwise false and nothing has to be closed</returns>
+	static bool open(const void* pAddress)
+	{
+		const uintptr_t first = reinterpret_cast<uintptr_t>(pAddress) & ~(PageProtection::pageSize - 1);
+		const uintptr_t last = (reinterpret_cast<uintptr_t>(pAddress) + sizeof(uintptr_t) - 1) & ~(PageProtection::pageSize - 1);
+
+		std::lock_guard<std::mutex> lock(PageProtection::mutex);
+
+		if (!PageProtection::openPage(first)) return false;
+		if (last != first && !PageProtection::openPage(last)) {
+			PageProtection::closePage(first);
+			return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Static. Closes the pages of a pointer opened with PageProtection::open, restoring their protection once no thread has them open.
+	/// </summary>
+	/// <param name="pAddress">: the pointer passed to PageProtection::open</param>
+	/// <returns>true unless restoring a protection failed</returns>
+	static bool close(const void* pAddress)
+	{
+		const uintptr_t first = reinterpret_cast<uintptr_t>(pAddress) & ~(PageProtection::pageSize - 1);
+		const uintptr_t last = (reinterpret_cast<uintptr_t>(pAddress) + sizeof(uintptr_t) - 1) & ~(PageProtection::pageSize - 1);
+
+		std::lock_guard<std::mutex> lock(PageProtection::mutex);
+
+		bool result = PageProtection::closePage(first);
+		if (last != first) result &= PageProtection::closePage(last);
+		return result;
+	}
+
+private:
+	struct Page {
+		DWORD oldProtect;
+		size_t openCount;
+	};
+
+	// Must be called with mutex held.
+	static bool openPage(uintptr_t base)
+	{
+		auto iter = PageProtection::pages.find(base);
+		if (iter != PageProtection::pages.end()) {
+			++iter->second.openCount;
+			return true;
+		}
+
+		DWORD oldProtect;
+		if (!VirtualProtect(reinterpret_cast<void*>(base), PageProtection::pageSize, PAGE_EXECUTE_READWRITE, &oldProtect)) return false;
+
+		PageProtection::pages.emplace(base, Page{ oldProtect, 1 });
+		return true;
+	}
+
+	// Must be called with mutex held.
+	static bool closePage(uintptr_t base)
+	{
+		auto iter = PageProtection::pages.find(base);
+		if (iter == PageProtection::pages.end()) return false;
+		if (--iter->second.openCount) return true;
+
+		DWORD oldProtect;
+		const bool result = !!VirtualProtect(reinterpret_cast<void*>(base), PageProtection::pageSize, iter->second.oldProtect, &oldProtect);
+		PageProtection::pages.erase(iter);
+		return result;
+	}
+
+	static inline std::mutex mutex{};
+	static inline std::unordered_map<uintptr_t, Page> pages{}; // the open pages by base address
+};
+
+/// <summary>
+/// Batches page protection changes for many pointer writes to potentially read-only memory.
+/// While a batch is alive, every VFTHookTemplate::rdataWrite on the same thread goes through it:
+/// the first write to a page opens it through PageProtection, later writes to that page need no system calls,
+/// and every page is closed once when the batch is committed or destroyed.
+/// Writes are still applied immediately and in the order they are requested, so the hook chaining protocol
+/// (link the chain, then publish the VFT entry) is observed by concurrent callers exactly as without a batch.
+/// The pages stay writable for the whole lifetime of the batch rather than for a single write, which widens the window
+/// in which stray writes to them go unnoticed. Keep batches short and commit them as soon as the writes are done.
+/// Batches nest, an inner batch joins the outermost one on the same thread.
+/// </summary>
+class VFTHookBatch {
+public:
+	VFTHookBatch() : owner(!VFTHookBatch::active)
+	{
+		if (this->owner) VFTHookBatch::active = this;
+	}
+
+	VFTHookBatch(const VFTHookBatch&) = delete;
+	VFTHookBatch& operator=(const VFTHookBatch&) = delete;
+
+	~VFTHookBatch()
+	{
+		this->commit();
+		if (this->owner) VFTHookBatch::active = nullptr;
+	}
+
+	/// <summary>
+	/// Static. Gets the batch pointer writes on the current thread are routed through.
+	/// </summary>
+	/// <returns>the outermost active batch on the current thread, otherwise nullptr</returns>
+	static VFTHookBatch* getActive() noexcept { return VFTHookBatch::active; }
+
+	/// <summary>
+	/// Writes a pointer, making its page writable first unless this batch already did.
+	/// </summary>
+	/// <param name="pAddress">: a pointer to the address in memory to be written to</param>
+	/// <param name="pointer">: a pointer to write to memory</param>
+	/// <returns>true on a successful write, otherwise false</returns>
+	template <typename T1, typename T2> bool write(T1* pAddress, T2* pointer)
+	{
+		if (!this->owner) return VFTHookBatch::active->write(pAddress, pointer);
+
+		if (!this->open(pAddress)) return false;
+
+		_mm_mfence();
+		*reinterpret_cast<uintptr_t*>(pAddress) = reinterpret_cast<uintptr_t>(pointer);
+		return true;
+	}
+
+	/// <summary>
+	/// Makes the memory of a pointer writable until this batch is committed, unless this batch already did.
+	/// </summary>
+	/// <param name="pAddress">: a pointer to the address in memory to be written to</param>
+	/// <returns>true if the memory is writable, otherwise false</returns>
+	bool open(const void* pAddress)
+	{
+		if (!this->owner) return VFTHookBatch::active->open(pAddress);
+
+		const uintptr_t address = reinterpret_cast<uintptr_t>(pAddress);
+		return this->openPage(address) && this->openPage(address + sizeof(uintptr_t) - 1);
+	}
+
+	/// <summary>
+	/// Closes every page opened by this batch, see PageProtection::close. The batch can be reused afterwards.
+	/// Has no effect on a batch which joined an outer one.
+	/// </summary>
+	/// <returns>true if all protections were restored, otherwise false</returns>
+	bool commit()
+	{
+		bool result = true;
+		for (uintptr_t page : this->pages) result &= PageProtection::close(reinterpret_cast<void*>(page));
+		this->pages.clear();
+		return result;
+	}
+
+private:
+	// Opens a page through PageProtection once per batch.
+	bool openPage(uintptr_t address)
+	{
+		const uintptr_t base = address & ~(PageProtection::pageSize - 1);
+		for (uintptr_t page : this->pages) {
+			if (page == base) return true;
+		}
+
+		if (!PageProtection::open(reinterpret_cast<void*>(base))) return false;
+
+		this->pages.push_back(base);
+		return true;
+	}
+
+	const bool owner;
+	std::vector<uintptr_t> pages; // base addresses of the pages opened by this batch
+
+	static inline thread_local VFTHookBatch* active = nullptr;
+};
+
+/// <summary>
+/// Deferred reclamation of hooks removed from their chains. A retired hook is destroyed once it is safe to do so:
+/// - every HookReclaimer::Guard that was active when it was retired has ended (epoch based),
+///   chain operations run inside of guards and may read any hook they reach, including ones being removed concurrently;
+/// - it is quiescent, no thread is using its contexts (see HookQuiescence), e.g. parked on the return address of an EntryHook;
+/// - no thread is found inside of it: every other thread is suspended in turn, and its instruction pointer, registers and stack
+///   are searched for addresses inside of the hook. This covers the threads a pool cannot tell about: one in the first instructions
+///   of a stub before it borrows a context, one in the shared pool routine, or one about to leave through jmp [fnHooked].
+/// A hook which is never quiescent, e.g. one around a function that never returns, is never destroyed.
+/// A stale copy of an address inside of a hook, left on a thread's stack by an earlier call, keeps it until the slot is overwritten.
+/// ThunkHook instances, instrumented or not, cannot tell whether a thread is still running their hook function, they are additionally
+/// kept until HookReclaimer::releaseThunks is called after they were retired.
+/// Retired hooks are checked whenever a hook is retired, by HookReclaimer::reclaim and HookReclaimer::drain,
+/// and asynchronously by a worker thread while it is running, see HookReclaimer::startWorker.
+/// </summary>
+class HookReclaimer {
+public:
+	/// <summary>
+	/// A critical section for reading hook chains, guards nest.
+	/// </summary>
+	class Guard {
+	public:
+		Guard() { HookReclaimer::enter(); }
+		~Guard() { HookReclaimer::leave(); }
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+	};
+
+	/// <summary>
+	/// Static. Hands over a hook which is no longer reachable from its chain to be destroyed once it is safe to do so.
+	/// </summary>
+	/// <param name="allocation">: the hook instance, allocated with HookAllocator</param>
+	/// <param name="destroy">: a function which destroys the hook instance and frees its memory</param>
+	/// <param name="isQuiescent">: a function which tells whether no thread is using the hook instance's contexts, nullptr if it has none</param>
+	/// <param name="usesThreadStacks">: whether the hook instance borrows contexts from the per-thread stacks, see HookThreadContext</param>
+	/// <param name="needsRelease">: whether the hook instance is kept until the next HookReclaimer::releaseThunks, see HookQuiescence</param>
+	/// <param name="reclaim">: whether to call HookReclaimer::reclaim, false when retiring several hooks at once</param>
+	static void retire(void* allocation, void (*destroy)(void*), bool (*isQuiescent)(void*) = nullptr, bool usesThreadStacks = false, bool needsRelease = false,
+		bool reclaim = true)
+	{
+		Retired* retired = new Retired{ allocation, destroy, isQuiescent, usesThreadStacks, needsRelease };
+		retired->size = HookAllocator::getSlotSize(allocation);
+		retired->epoch = HookReclaimer::epoch.fetch_add(1);
+		retired->sweep = HookThreadContext::getSweep();
+		retired->release = HookReclaimer::releases.load();
+
+		++HookReclaimer::pending;
+		HookReclaimer::push(retired);
+		if (reclaim) HookReclaimer::reclaim();
+	}
+
+	/// <summary>
+	/// Static. Destroys every retired hook which is safe to destroy, without waiting.
+	/// </summary>
+	/// <returns>true if no retired hooks are left, otherwise false</returns>
+	static bool reclaim()
+	{
+		Retired* retired = HookReclaimer::retired.exchange(nullptr);
+		if (!retired) return !HookReclaimer::pending.load();
+
+		// the oldest epoch any guard was entered in
+		uint64_t oldest = UINT64_MAX;
+		for (Participant* participant = HookReclaimer::participants.load(); participant; participant = participant->next) {
+			const uint64_t entered = participant->epoch.load();
+			if (entered && entered < oldest) oldest = entered;
+		}
+
+		const uint64_t stackSweep = HookThreadContext::sweep();
+		const uint64_t release = HookReclaimer::releases.load();
+
+		std::vector<Retired*> candidates;
+		while (retired) {
+			Retired* next = retired->next;
+
+			const bool quiescent = retired->epoch < oldest
+				&& (!retired->isQuiescent || retired->isQuiescent(retired->allocation))
+				&& (!retired->usesThreadStacks || stackSweep > retired->sweep)
+				&& (!retired->needsRelease || release > retired->release);
+
+			if (quiescent) candidates.push_back(retired);
+			else HookReclaimer::push(retired);
+			retired = next;
+		}
+
+		HookReclaimer::findThreads(candidates);
+		for (Retired* candidate : candidates) {
+			if (candidate->inUse) {
+				candidate->inUse = false;
+				HookReclaimer::push(candidate);
+				continue;
+			}
+			candidate->destroy(candidate->allocation);
+			delete candidate;
+			--HookReclaimer::pending;
+		}
+
+		return !HookReclaimer::pending.load();
+	}
+
+	/// <summary>
+	/// Static. Declares that no thread is running the hook function of a ThunkHook retired so far, nor about to jump through its trampoline,
+	/// e.g. once the code paths calling the hooked functions are known to be idle. Lets those ThunkHook instances be destroyed.
+	/// </summary>
+	static void releaseThunks()
+	{
+		HookReclaimer::releases.fetch_add(1);
+		HookReclaimer::reclaim();
+	}
+
+	/// <summary>
+	/// Static. Waits until every retired hook has been destroyed, e.g. before unloading the module which placed the hooks.
+	/// Retired ThunkHook instances are only waited for after HookReclaimer::releaseThunks, drain times out on them otherwise.
+	/// </summary>
+	/// <param name="timeout">: the maximum amount of time to wait for</param>
+	/// <returns>true if no retired hooks are left, otherwise false if some are still in use after the timeout</returns>
+	static bool drain(std::chrono::milliseconds timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (!HookReclaimer::reclaim()) {
+			if (std::chrono::steady_clock::now() >= deadline) return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Static. Starts a worker thread destroying retired hooks in the background, if it is not running already.
+	/// The worker must be stopped with HookReclaimer::stopWorker before the module is unloaded (and outside of DllMain).
+	/// </summary>
+	/// <param name="interval">: how often the worker checks the retired hooks</param>
+	static void startWorker(std::chrono::milliseconds interval = std::chrono::milliseconds(16))
+	{
+		std::lock_guard<std::mutex> lock(HookReclaimer::workerMutex);
+		if (HookReclaimer::worker.thread.joinable()) return;
+
+		HookReclaimer::worker.stopping = false;
+		HookReclaimer::worker.thread = std::thread([interval]() {
+			std::unique_lock<std::mutex> lock(HookReclaimer::workerMutex);
+			while (!HookReclaimer::worker.stopping) {
+				lock.unlock();
+				HookReclaimer::reclaim();
+				lock.lock();
+				HookReclaimer::worker.signal.wait_for(lock, interval, []() { return HookReclaimer::worker.stopping; });
+			}
+		});
+	}
+
+	/// <summary>
+	/// Static. Stops the worker thread started by HookReclaimer::startWorker and waits for it to exit.
+	/// </summary>
+	static void stopWorker()
+	{
+		std::thread thread;
+		{
+			std::lock_guard<std::mutex> lock(HookReclaimer::workerMutex);
+			HookReclaimer::worker.stopping = true;
+			thread = std::move(HookReclaimer::worker.thread);
+		}
+		HookReclaimer::worker.signal.notify_all();
+		if (thread.joinable()) thread.join();
+	}
+
+private:
+	struct Participant {
+		std::atomic<uint64_t> epoch{ 0 }; // the epoch the current guard was entered in, 0 outside of guards
+		std::atomic<bool> used{ true };
+		unsigned int depth = 0;
+		Participant* next = nullptr;
+	};
+
+	struct Retired {
+		void* allocation;
+		void (*destroy)(void*);
+		bool (*isQuiescent)(void*);
+		bool usesThreadStacks;
+		bool needsRelease;
+		bool inUse = false; // found inside of a thread by the latest findThreads
+		size_t size = 0; // the size of the allocation, see HookAllocator::getSlotSize
+		uint64_t epoch = 0;
+		uint64_t sweep = 0; // the thread stack sweep at retirement, see HookThreadContext::sweep
+		uint64_t release = 0; // the releases at retirement, see HookReclaimer::releaseThunks
+		Retired* next = nullptr;
+	};
+
+	// A worker thread still running at exit is told to stop and left behind, joining it during module unload would deadlock.
+	struct Worker {
+		Worker() : stopping(false) {}
+
+		~Worker()
+		{
+			if (!this->thread.joinable()) return;
+
+			{
+				std::lock_guard<std::mutex> lock(HookReclaimer::workerMutex);
+				this->stopping = true;
+			}
+			this->signal.notify_all();
+			this->thread.detach();
+		}
+
+		std::thread thread;
+		std::condition_variable signal;
+		bool stopping;
+	};
+
+	// Releases the participant record of a thread when it exits, to be reused by other threads.
+	struct Owner {
+		~Owner() { if (this->participant) this->participant->used.store(false); }
+
+		Participant* participant = nullptr;
+	};
+
+	static Participant* getParticipant()
+	{
+		static thread_local Owner owner{};
+		if (owner.participant) return owner.participant;
+
+		for (Participant* participant = HookReclaimer::participants.load(); participant; participant = participant->next) {
+			bool used = false;
+			if (participant->used.compare_exchange_strong(used, true)) return owner.participant = participant;
+		}
+
+		Participant* participant = new Participant{};
+		participant->next = HookReclaimer::participants.load();
+		while (!HookReclaimer::participants.compare_exchange_weak(participant->next, participant));
+		return owner.participant = participant;
+	}
+
+	static void enter()
+	{
+		Participant* participant = HookReclaimer::getParticipant();
+		if (participant->depth++) return;
+
+		// the epoch is published before any hook is read
+		participant->epoch.store(HookReclaimer::epoch.load());
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	static void leave()
+	{
+		Participant* participant = HookReclaimer::getParticipant();
+		if (--participant->depth) return;
+
+		participant->epoch.store(0);
+	}
+
+	// Marks the candidates which a thread other than the calling one may still be inside of, see the class summary.
+	// Threads are suspended one at a time: once a thread was seen outside of an unlinked hook, it cannot reach it anymore.
+	// Nothing is allocated while a thread is suspended, it may be holding the heap lock.
+	// The calling thread is not inspected, a hook function retiring its own hook is covered by the hook's pool.
+	static void findThreads(std::vector<Retired*>& candidates)
+	{
+		if (candidates.empty()) return;
+
+		std::sort(candidates.begin(), candidates.end(), [](const Retired* a, const Retired* b) { return a->allocation < b->allocation; });
+		auto markAll = [&candidates]() { for (Retired* candidate : candidates) candidate->inUse = true; };
+
+		HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+		if (snapshot == INVALID_HANDLE_VALUE) return markAll();
+
+		std::vector<DWORD> threadIds;
+		const DWORD processId = GetCurrentProcessId();
+		const DWORD threadId = GetCurrentThreadId();
+		THREADENTRY32 entry{};
+		entry.dwSize = sizeof(entry);
+		for (BOOL found = Thread32First(snapshot, &entry); found; found = Thread32Next(snapshot, &entry)) {
+			if (entry.th32OwnerProcessID == processId && entry.th32ThreadID != threadId) threadIds.push_back(entry.th32ThreadID);
+		}
+		CloseHandle(snapshot);
+
+		for (DWORD id : threadIds) {
+			// threads which have exited since the snapshot cannot be opened
+			HANDLE thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT, FALSE, id);
+			if (!thread) continue;
+
+			bool inspected = false;
+			if (SuspendThread(thread) != static_cast<DWORD>(-1)) {
+				CONTEXT context{};
+				context.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+				inspected = GetThreadContext(thread, &context) && HookReclaimer::inspect(context, candidates);
+				ResumeThread(thread);
+			}
+			CloseHandle(thread);
+
+			// a thread which could not be inspected may be inside of any of them
+			if (!inspected) return markAll();
+		}
+	}
+
+	// Marks the candidates the registers or the stack of a suspended thread point into.
+	static bool inspect(const CONTEXT& context, std::vector<Retired*>& candidates)
+	{
+		const DWORD64 registers[] = {
+			context.Rip, context.Rax, context.Rcx, context.Rdx, context.Rbx, context.Rbp, context.Rsi, context.Rdi,
+			context.R8, context.R9, context.R10, context.R11, context.R12, context.R13, context.R14, context.R15,
+		};
+		for (DWORD64 value : registers) HookReclaimer::mark(candidates, static_cast<uintptr_t>(value));
+
+		// the committed part of the stack from the stack pointer up to its base
+		MEMORY_BASIC_INFORMATION region{};
+		if (!VirtualQuery(reinterpret_cast<void*>(context.Rsp), &region, sizeof(region)) || region.State != MEM_COMMIT) return false;
+
+		const uintptr_t end = reinterpret_cast<uintptr_t>(region.BaseAddress) + region.RegionSize;
+		for (uintptr_t slot = context.Rsp & ~(sizeof(uintptr_t) - 1); slot < end; slot += sizeof(uintptr_t)) {
+			HookReclaimer::mark(candidates, *reinterpret_cast<const uintptr_t*>(slot));
+		}
+		return true;
+	}
+
+	// Marks the candidate an address points into, candidates are sorted by address.
+	static void mark(std::vector<Retired*>& candidates, uintptr_t address)
+	{
+		auto above = std::upper_bound(candidates.begin(), candidates.end(), address, [](uintptr_t address, const Retired* candidate) {
+			return address < reinterpret_cast<uintptr_t>(candidate->allocation);
+		});
+		if (above == candidates.begin()) return;
+
+		Retired* candidate = *(above - 1);
+		if (address - reinterpret_cast<uintptr_t>(candidate->allocation) < candidate->size) candidate->inUse = true;
+	}
+
+	static void push(Retired* retired)
+	{
+		retired->next = HookReclaimer::retired.load();
+		while (!HookReclaimer::retired.compare_exchange_weak(retired->next, retired));
+	}
+
+	static inline std::atomic<uint64_t> epoch{ 1 };
+	static inline std::atomic<Participant*> participants{ nullptr };
+	static inline std::atomic<Retired*> retired{ nullptr };
+	static inline std::atomic<size_t> pending{ 0 }; // hooks retired and not yet destroyed
+	static inline std::atomic<uint64_t> releases{ 0 }; // calls to releaseThunks
+	static inline std::mutex workerMutex{};
+	static inline Worker worker{};
+};
+
+/// <summary>
+/// Lock-free insertion and removal of hooks in the chain of a virtual function table entry.
+/// The fnHooked pointers, starting from the VFT entry, are the chain: every change is a single compare-exchange on one of them.
+/// An insertion takes effect (is linearized) at the compare-exchange of the VFT entry,
+/// a removal at the compare-exchange of the link pointing to the removed hook.
+/// Removing two neighbouring hooks at once may briefly relink a removed hook, each removal verifies and repairs the chain afterwards.
+/// The previous pointers are kept up to date on a best effort basis for hooks placed with older versions, which lock HookBase::mutex instead.
+/// All of the functions must be called inside of a HookReclaimer::Guard.
+/// </summary>
+class HookChain {
+public:
+	/// <summary>
+	/// Static. Places a hook at the top of the chain of a virtual function table entry.
+	/// </summary>
+	/// <param name="vftEntry">: the virtual function table entry</param>
+	/// <param name="hook">: the hook instance, with everything but fnHooked and previous set up</param>
+	/// <returns>true on success, otherwise false if the entry could not be written</returns>
+	static bool insert(void** vftEntry, void* hook)
+	{
+		HookBase* hookData = reinterpret_cast<HookBase*>(hook);
+		void* entry = HookChain::getEntry(hookData);
+
+		Writable writable(vftEntry);
+		if (!writable) return false;
+
+		hookData->previous = vftEntry;
+		for (;;) {
+			void* top = HookChain::load(vftEntry);
+			hookData->fnHooked = top;
+
+			// linearization point of the insertion, the hook is fully set up before it is published
+			if (!HookChain::compareExchange(vftEntry, top, entry)) continue;
+
+			if (HookBase* topHook = HookChain::getHook(top)) topHook->previous = hookData;
+			return true;
+		}
+	}
+
+	/// <summary>
+	/// Static. Removes a hook from the chain of a virtual function table entry.
+	/// The hook stays readable for concurrent chain operations, it must be retired with HookReclaimer::retire.
+	/// </summary>
+	/// <param name="vftEntry">: the virtual function table entry</param>
+	/// <param name="hook">: the hook instance</param>
+	/// <returns>true on success, otherwise false if the entry could not be written</returns>
+	static bool remove(void** vftEntry, void* hook)
+	{
+		Writable writable(vftEntry);
+		if (!writable) return false;
+
+		HookChain::relink(vftEntry, reinterpret_cast<HookBase*>(hook), reinterpret_cast<HookBase*>(hook), nullptr, nullptr);
+		return true;
+	}
+
+	/// <summary>
+	/// Static. Replaces a run of consecutive hooks in the chain of a virtual function table entry with another run of hooks, see HookChainCompiler.
+	/// Takes effect at a single compare-exchange like a removal, concurrent removals of the neighbouring hooks are repaired the same way.
+	/// The replaced hooks stay readable for concurrent chain operations, they must be retired with HookReclaimer::retire or kept alive.
+	/// </summary>
+	/// <param name="vftEntry">: the virtual function table entry</param>
+	/// <param name="first">: the topmost hook of the run to replace</param>
+	/// <param name="last">: the bottommost hook of the run to replace, the same as first for a single hook</param>
+	/// <param name="replacementFirst">: the topmost hook of the replacement run</param>
+	/// <param name="replacementLast">: the bottommost hook of the replacement run, its fnHooked is linked to the rest of the chain</param>
+	/// <returns>true on success, otherwise false if the entry could not be written or the run is not in the chain</returns>
+	static bool replace(void** vftEntry, void* first, void* last, void* replacementFirst, void* replacementLast)
+	{
+		Writable writable(vftEntry);
+		if (!writable) return false;
+
+		return HookChain::relink(vftEntry, reinterpret_cast<HookBase*>(first), reinterpret_cast<HookBase*>(last),
+			reinterpret_cast<HookBase*>(replacementFirst), reinterpret_cast<HookBase*>(replacementLast));
+	}
+
+	/// <summary>
+	/// Static. Places a hook shared by several virtual function table entries at one of them, see VFTHookGroupTemplate.
+	/// A shared hook can only be placed at entries which are not hooked yet, the rest of the chain would differ between them otherwise:
+	/// fnHooked must already hold the function of the entry.
+	/// The previous pointer of a shared hook refers to the first entry it was placed at.
+	/// </summary>
+	/// <param name="vftEntry">: the virtual function table entry</param>
+	/// <param name="hook">: the hook instance, with everything but previous set up</param>
+	/// <returns>true on success, otherwise false if the entry could not be written or no longer holds fnHooked</returns>
+	static bool insertShared(void** vftEntry, void* hook)
+	{
+		HookBase* hookData = reinterpret_cast<HookBase*>(hook);
+
+		Writable writable(vftEntry);
+		if (!writable) return false;
+
+		if (!hookData->previous) hookData->previous = vftEntry;
+		return HookChain::compareExchange(vftEntry, hookData->fnHooked, HookChain::getEntry(hookData));
+	}
+
+	/// <summary>
+	/// Static. Follows a chain down to the function at its bottom, the one called once every hook in it has run.
+	/// </summary>
+	/// <param name="function">: a virtual function table entry's value, a hook or the original function</param>
+	/// <returns>the original function, the function itself if it is not a hook</returns>
+	static void* getOriginal(void* function)
+	{
+		while (HookBase* hook = HookChain::getHook(function)) function = HookChain::load(&hook->fnHooked);
+		return function;
+	}
+
+private:
+	// Keeps a virtual function table entry writable for the lifetime of the object, batched if a VFTHookBatch is active.
+	// Goes through PageProtection, concurrent chain operations on the same page never restore its protection under each other.
+	class Writable {
+	public:
+		Writable(void** vftEntry) : vftEntry(vftEntry)
+		{
+			if (VFTHookBatch* batch = VFTHookBatch::getActive()) {
+				this->writable = batch->open(vftEntry);
+				this->close = false;
+			}
+			else {
+				this->writable = PageProtection::open(vftEntry);
+				this->close = this->writable;
+			}
+		}
+
+		~Writable()
+		{
+			if (this->close) PageProtection::close(this->vftEntry);
+		}
+
+		explicit operator bool() const { return this->writable; }
+
+	private:
+		void** vftEntry;
+		bool writable = false;
+		bool close = false;
+	};
+
+	friend class HookChainCompiler;
+
+	static constexpr unsigned long long magic = 0x6B6F6F48696E55ull; // see HookBase::magic
+
+	// Unlinks the run of hooks from first to last, linking the replacement run in its place if there is one.
+	// Returns false if the run was not in the chain.
+	static bool relink(void** vftEntry, HookBase* first, HookBase* last, HookBase* replacementFirst, HookBase* replacementLast)
+	{
+		void* entry = HookChain::getEntry(first);
+		bool relinked = false;
+
+		for (;;) {
+			void** link = HookChain::findLink(vftEntry, entry);
+			if (!link) break; // not (or no longer) in the chain
+
+			void* next = HookChain::load(&last->fnHooked);
+			if (replacementLast) replacementLast->fnHooked = next;
+
+			// linearization point of the removal
+			if (!HookChain::compareExchange(link, entry, replacementFirst ? HookChain::getEntry(replacementFirst) : next)) continue;
+			relinked = true;
+
+			// the next hook may have been removed in the meantime, in which case the link now holds a stale copy of it
+			for (void* current; (current = HookChain::load(&last->fnHooked)) != next; next = current) {
+				void** stale = HookChain::findLink(vftEntry, next);
+				if (stale) HookChain::compareExchange(stale, next, current);
+			}
+
+			// the previous hook may have been removed in the meantime,
+			// in which case its removal may have relinked this hook and it has to be removed again
+			if (link == vftEntry || HookChain::findLink(vftEntry, HookChain::getEntry(HookChain::getLinkOwner(link)))) break;
+		}
+
+		if (replacementFirst) replacementFirst->previous = first->previous;
+		if (HookBase* nextHook = HookChain::getHook(last->fnHooked)) nextHook->previous = replacementLast ? replacementLast : first->previous;
+		return relinked;
+	}
+
+	static void* load(void** link) { return *const_cast<void* volatile*>(link); }
+
+	static bool compareExchange(void** link, void* expected, void* desired)
+	{
+		return _InterlockedCompareExchangePointer(const_cast<void* volatile*>(link), desired, expected) == expected;
+	}
+
+	static void* getEntry(HookBase* hook) { return reinterpret_cast<uint8_t*>(hook) + sizeof(HookBase); }
+
+	// the hook data is above the actual hook function pointed at
+	static HookBase* getHook(void* function)
+	{
+		HookBase* hook = reinterpret_cast<HookBase*>(reinterpret_cast<uintptr_t>(function) - sizeof(HookBase));
+		return hook->magic == HookChain::magic ? hook : nullptr;
+	}
+
+	static HookBase* getLinkOwner(void** link)
+	{
+		return reinterpret_cast<HookBase*>(reinterpret_cast<uintptr_t>(link) - offsetof(HookBase, fnHooked));
+	}
+
+	// Finds the link pointing to a function by walking the chain, returns nullptr if the function is not in the chain.
+	static void** findLink(void** vftEntry, void* function)
+	{
+		void** link = vftEntry;
+		for (;;) {
+			void* current = HookChain::load(link);
+			if (current == function) return link;
+
+			HookBase* hook = HookChain::getHook(current);
+			if (!hook) return nullptr;
+			link = &hook->fnHooked;
+		}
+	}
+};
+
+/// <summary>
+/// Flattens hook chains: a run of EntryHook instances placed by VFTHookTemplate in the chain of a virtual function table entry
+/// is replaced with one generated stub, which borrows a single context and calls all of their hook functions in chain order
+/// before moving on to the rest of the chain. A call then costs one context borrow and one argument spill however long the run is.
+/// The flattened hooks are parked, taken out of the chain but kept alive, and every VFTHookTemplate instance stays individually removable:
+/// deleting one rebuilds the stub without its hook function, and once a single hook is left it is linked back into the chain.
+/// Hooks placed later are chained on top of the stub as usual, until the entry is compiled again.
+/// Only EntryHook and EntryHookV types (with any Borrow and Return) are flattened, hooks of other types and modules and VFTHookGroup hooks stay in the chain.
+/// The stub replaces the run its previous stub is in, otherwise the first run of at least two flattenable hooks from the top of the chain.
+/// A call which was already inside of a stub when it was rebuilt may still call the hook function of a removed hook,
+/// the replaced stubs are retired to HookReclaimer, so HookReclaimer::drain waits for such calls as well.
+/// </summary>
+class HookChainCompiler {
+public:
+	/// <summary>
+	/// Static. Flattens the hook chain of a virtual function table entry, or adds the hooks placed on top of its stub since it was compiled.
+	/// </summary>
+	/// <param name="pVirtualFunctionTable">: pointer to the virtual function table</param>
+	/// <param name="vftIndex">: index of the virtual function inside of the virtual function table</param>
+	/// <returns>true if the entry's hooks are flattened, otherwise false if there are less than two to flatten or the stub could not be placed</returns>
+	template <typename Vft> static bool compile(Vft* pVirtualFunctionTable, const unsigned int vftIndex)
+	{
+		return HookChainCompiler::compile(&reinterpret_cast<void**>(pVirtualFunctionTable)[vftIndex]);
+	}
+
+	/// <summary>
+	/// Static. Links the flattened hooks of a virtual function table entry back into its chain, in their order, and removes the stub.
+	/// </summary>
+	/// <param name="pVirtualFunctionTable">: pointer to the virtual function table</param>
+	/// <param name="vftIndex">: index of the virtual function inside of the virtual function table</param>
+	/// <returns>true if the entry's hooks were flattened and are back in the chain, otherwise false</returns>
+	template <typename Vft> static bool decompile(Vft* pVirtualFunctionTable, const unsigned int vftIndex)
+	{
+		void** vftEntry = &reinterpret_cast<void**>(pVirtualFunctionTable)[vftIndex];
+
+		std::lock_guard<std::mutex> lock(HookChainCompiler::mutex);
+		HookReclaimer::Guard guard{};
+
+		auto compiled = HookChainCompiler::entries.find(vftEntry);
+		return compiled != HookChainCompiler::entries.end() && HookChainCompiler::unpark(vftEntry, compiled, compiled->second.hooks);
+	}
+
+	/// <summary>
+	/// Static. Gets the amount of hook functions the stub of a virtual function table entry calls.
+	/// </summary>
+	/// <param name="pVirtualFunctionTable">: pointer to the virtual function table</param>
+	/// <param name="vftIndex">: index of the virtual function inside of the virtual function table</param>
+	/// <returns>the amount of flattened hooks, 0 if the entry is not compiled</returns>
+	template <typename Vft> static size_t getFlattenedCount(Vft* pVirtualFunctionTable, const unsigned int vftIndex)
+	{
+		void** vftEntry = &reinterpret_cast<void**>(pVirtualFunctionTable)[vftIndex];
+
+		std::lock_guard<std::mutex> lock(HookChainCompiler::mutex);
+		auto compiled = HookChainCompiler::entries.find(vftEntry);
+		return compiled != HookChainCompiler::entries.end() ? compiled->second.hooks.size() : 0;
+	}
+
+	/// <summary>
+	/// Static. Makes a hook placed by VFTHookTemplate available for flattening.
+	/// </summary>
+	/// <param name="hook">: the hook instance, already in its chain</param>
+	/// <param name="vector">: whether the hook is an EntryHookV type, preserving the vector argument registers</param>
+	static void add(void* hook, bool vector)
+	{
+		std::lock_guard<std::mutex> lock(HookChainCompiler::mutex);
+		HookChainCompiler::registered[reinterpret_cast<HookBase*>(hook)] = vector;
+	}
+
+	/// <summary>
+	/// Static. Removes a hook added with HookChainCompiler::add from its chain, or from the stub it is flattened into, rebuilding the stub.
+	/// The hook must be retired with HookReclaimer::retire afterwards, unless it could not be removed.
+	/// </summary>
+	/// <param name="vftEntry">: the virtual function table entry</param>
+	/// <param name="hook">: the hook instance</param>
+	/// <returns>true if the hook was removed, otherwise false if it is still reachable from its chain or stub</returns>
+	static bool remove(void** vftEntry, void* hook)
+	{
+		HookBase* hookData = reinterpret_cast<HookBase*>(hook);
+
+		std::lock_guard<std::mutex> lock(HookChainCompiler::mutex);
+		HookReclaimer::Guard guard{};
+
+		auto compiled = HookChainCompiler::entries.find(vftEntry);
+		if (compiled != HookChainCompiler::entries.end()) {
+			const std::vector<Flattened>& hooks = compiled->second.hooks;
+			auto flattened = std::find_if(hooks.begin(), hooks.end(), [hookData](const Flattened& parked) { return parked.hook == hookData; });
+			if (flattened != hooks.end()) {
+				std::vector<Flattened> remaining(hooks.begin(), flattened);
+				remaining.insert(remaining.end(), flattened + 1, hooks.end());
+
+				// threads which entered the parked hook above before it was parked continue past the removed one
+				HookBase* previous = flattened != hooks.begin() ? (flattened - 1)->hook : nullptr;
+				void* previousLink = previous ? HookChain::load(&previous->fnHooked) : nullptr;
+				if (previous) HookChainCompiler::store(&previous->fnHooked, HookChain::load(&hookData->fnHooked));
+
+				// the stub still calls the hook function until it is replaced, the hook is only forgotten once that succeeded
+				if (!HookChainCompiler::rebuild(vftEntry, compiled, std::move(remaining))) {
+					if (previous) HookChainCompiler::store(&previous->fnHooked, previousLink);
+					return false;
+				}
+				HookChainCompiler::registered.erase(hookData);
+				return true;
+			}
+		}
+
+		if (!HookChain::remove(vftEntry, hook)) return false;
+		HookChainCompiler::registered.erase(hookData);
+		return true;
+	}
+
+private:
+	struct Flattened {
+		HookBase* hook;
+		bool vector;
+	};
+
+	struct Compiled {
+		HookBase* stub;
+		bool vector; // whether the stub preserves the vector argument registers and has a HookContext pool
+		std::vector<Flattened> hooks; // in chain order
+	};
+
+	static bool compile(void** vftEntry)
+	{
+		std::lock_guard<std::mutex> lock(HookChainCompiler::mutex);
+		HookReclaimer::Guard guard{};
+
+		auto compiled = HookChainCompiler::entries.find(vftEntry);
+		HookBase* stub = compiled != HookChainCompiler::entries.end() ? compiled->second.stub : nullptr;
+
+		// collect the runs of flattenable hooks from the top of the chain down
+		std::vector<HookBase*> run, candidate;
+		auto select = [&]() {
+			const bool hasStub = stub && std::find(candidate.begin(), candidate.end(), stub) != candidate.end();
+			if (hasStub || (!stub && run.empty() && candidate.size() >= 2)) run = candidate;
+			candidate.clear();
+			return hasStub;
+		};
+		for (void* current = HookChain::load(vftEntry); HookBase* hook = HookChain::getHook(current); current = HookChain::load(&hook->fnHooked)) {
+			if (hook == stub || HookChainCompiler::registered.count(hook)) candidate.push_back(hook);
+			else if (select()) break;
+		}
+		select();
+
+		if (run.empty()) return false;
+		if (run.size() == 1 && run.front() == stub) return true;
+
+		std::vector<Flattened> hooks;
+		for (HookBase* hook : run) {
+			if (hook == stub) hooks.insert(hooks.end(), compiled->second.hooks.begin(), compiled->second.hooks.end());
+			else hooks.push_back({ hook, HookChainCompiler::registered[hook] });
+		}
+
+		const bool vector = HookChainCompiler::isVector(hooks);
+		HookBase* replacement = HookChainCompiler::build(hooks, vector);
+		if (!replacement) return !!stub;
+
+		if (!HookChain::replace(vftEntry, run.front(), run.back(), replacement, replacement)) {
+			HookChainCompiler::destroy(replacement, vector);
+			return !!stub;
+		}
+
+		HookChainCompiler::park(hooks, replacement);
+		if (stub) HookChainCompiler::retire(stub, compiled->second.vector);
+		HookChainCompiler::entries[vftEntry] = Compiled{ replacement, vector, std::move(hooks) };
+		return true;
+	}
+
+	// Replaces the stub of an entry with one calling a changed set of hooks, or links them back into the chain if less than two are left.
+	// The entry keeps its stub and hooks if neither could be placed.
+	static bool rebuild(void** vftEntry, std::unordered_map<void**, Compiled>::iterator compiled, std::vector<Flattened> hooks)
+	{
+		Compiled& entry = compiled->second;
+		if (hooks.size() >= 2) {
+			const bool vector = HookChainCompiler::isVector(hooks);
+			if (HookBase* replacement = HookChainCompiler::build(hooks, vector)) {
+				if (HookChain::replace(vftEntry, entry.stub, entry.stub, replacement, replacement)) {
+					HookChainCompiler::park(hooks, replacement);
+					HookChainCompiler::retire(entry.stub, entry.vector);
+					entry.stub = replacement;
+					entry.vector = vector;
+					entry.hooks = std::move(hooks);
+					return true;
+				}
+				HookChainCompiler::destroy(replacement, vector);
+			}
+		}
+
+		// no memory for a new stub falls back to the chain as well
+		return HookChainCompiler::unpark(vftEntry, compiled, hooks);
+	}
+
+	// Links hooks back into the chain of an entry in place of its stub, and retires the stub.
+	static bool unpark(void** vftEntry, std::unordered_map<void**, Compiled>::iterator compiled, const std::vector<Flattened>& hooks)
+	{
+		Compiled& entry = compiled->second;
+		for (size_t i = 0; i + 1 < hooks.size(); ++i) {
+			HookChainCompiler::store(&hooks[i].hook->fnHooked, HookChain::getEntry(hooks[i + 1].hook));
+		}
+		if (!HookChain::replace(vftEntry, entry.stub, entry.stub, hooks.front().hook, hooks.back().hook)) return false;
+
+		HookChainCompiler::retire(entry.stub, entry.vector);
+		HookChainCompiler::entries.erase(compiled);
+		return true;
+	}
+
+	// Links the parked hooks to each other and to the rest of the chain below the stub.
+	// They are only followed by threads which entered one of them before it was parked.
+	// The bottommost one leads to the forwarding jump of the stub rather than to a copy of its fnHooked,
+	// which would go stale, and could lead to a freed hook, once the chain below the stub changes.
+	static void park(const std::vector<Flattened>& hooks, HookBase* stub)
+	{
+		for (size_t i = 0; i + 1 < hooks.size(); ++i) {
+			HookChainCompiler::store(&hooks[i].hook->fnHooked, HookChain::getEntry(hooks[i + 1].hook));
+		}
+		HookChainCompiler::store(&hooks.back().hook->fnHooked, HookChainCompiler::getForward(stub, hooks.size()));
+	}
+
+	// The jmp [fnHooked] placed after the function table of a stub calling count hook functions, see HookChainCompiler::build.
+	static void* getForward(HookBase* stub, size_t count)
+	{
+		return reinterpret_cast<void**>(stub->extra) + count;
+	}
+
+	static bool isVector(const std::vector<Flattened>& hooks)
+	{
+		return std::any_of(hooks.begin(), hooks.end(), [](const Flattened& hook) { return hook.vector; });
+	}
+
+	static void store(void** link, void* value) { _InterlockedExchangePointer(const_cast<void* volatile*>(link), value); }
+
+	static HookBase* build(const std::vector<Flattened>& hooks, bool vector)
+	{
+		return vector ? HookChainCompiler::build<HookContext>(hooks) : HookChainCompiler::build<HookIntegerContext>(hooks);
+	}
+
+	// Generates a stub calling the hook functions in order, set up to be placed into a chain with HookChain::replace.
+	// The stub is a hook instance of its own: the hook data, followed by the assembly and the table of hook functions, which extra points to.
+	// The table is followed by a jump to the stub's fnHooked, for the parked hooks, see HookChainCompiler::park.
+	// Every hook function is called with the original arguments, stack arguments included, above its return address, like from an EntryHook.
+	template <typename Context> static HookBase* build(const std::vector<Flattened>& hooks)
+	{
+		constexpr bool vector = std::is_same_v<Context, HookContext>;
+
+		std::vector<uint8_t> code;
+		std::vector<std::pair<size_t, size_t>> calls; // the displacement of every call and the index of its function
+
+		auto emit = [&code](std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); };
+		auto emitDisplacement = [&code](int32_t displacement) {
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&displacement);
+			code.insert(code.end(), bytes, bytes + sizeof(displacement));
+		};
+		// an instruction addressing a field of the hook data relative to rip, the displacement comes last
+		auto emitField = [&](std::initializer_list<uint8_t> bytes, size_t offset) {
+			emit(bytes);
+			emitDisplacement(static_cast<int32_t>(offset) - static_cast<int32_t>(sizeof(HookBase) + code.size() + sizeof(int32_t)));
+		};
+		// movaps between xmm0-xmm5 and the context in rax
+		auto emitVectors = [&](uint8_t opcode) {
+			for (uint8_t i = 0; i < 6; ++i) {
+				emit({ 0x0F, opcode, static_cast<uint8_t>(0x80 | i << 3) });
+				emitDisplacement(static_cast<int32_t>(offsetof(HookContext, imm0) + i * sizeof(HookContext::imm256)));
+			}
+		};
+		auto emitArguments = [&]() {
+			emit({
+				0x4C, 0x89, 0xE0,                         // mov    rax,r12
+				0x48, 0x8B, 0x48, 0x10,                   // mov    rcx,[reg64_rcx]
+				0x48, 0x8B, 0x50, 0x18,                   // mov    rdx,[reg64_rdx]
+				0x4C, 0x8B, 0x40, 0x40,                   // mov    r8,[reg64_r8]
+				0x4C, 0x8B, 0x48, 0x48,                   // mov    r9,[reg64_r9]
+			});
+			if constexpr (vector) emitVectors(0x28);
+		};
+
+		const HookBorrowContext borrow{};
+		const HookReturnContext giveBack{};
+
+		emitField({ 0x4C, 0x8B, 0x15 }, offsetof(HookBase, pool)); // mov    r10,[pool]
+		code.insert(code.end(), std::begin(borrow.asmRaw), std::end(borrow.asmRaw));
+		emit({
+			0x48, 0x89, 0x48, 0x10,                   // mov    [reg64_rcx],rcx
+			0x48, 0x89, 0x50, 0x18,                   // mov    [reg64_rdx],rdx
+			0x4C, 0x89, 0x40, 0x40,                   // mov    [reg64_r8],r8
+			0x4C, 0x89, 0x48, 0x48,                   // mov    [reg64_r9],r9
+		});
+		if constexpr (vector) emitVectors(0x29);
+		emit({ 0x8F, 0x00 });                         // pop    [reg64_rax] <- old_return
+
+		for (size_t i = 0; i < hooks.size(); ++i) {
+			if (i) emitArguments();
+			emit({ 0xFF, 0x15 });                     // call   [function]
+			calls.emplace_back(code.size(), i);
+			emitDisplacement(0);
+		}
+
+		emitArguments();
+		emit({ 0xFF, 0x30 });                         // push   [reg64_rax]
+		emitField({ 0x4C, 0x8B, 0x15 }, offsetof(HookBase, pool)); // mov    r10,[pool]
+		code.insert(code.end(), std::begin(giveBack.asmRaw), std::end(giveBack.asmRaw));
+		emitField({ 0xFF, 0x25 }, offsetof(HookBase, fnHooked)); // jmp    [fnHooked]
+
+		const size_t tableOffset = (sizeof(HookBase) + code.size() + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+		for (const auto& call : calls) {
+			const int32_t displacement = static_cast<int32_t>(tableOffset + call.second * sizeof(void*) - (sizeof(HookBase) + call.first + sizeof(int32_t)));
+			memcpy(code.data() + call.first, &displacement, sizeof(displacement));
+		}
+
+		const size_t forwardOffset = tableOffset + hooks.size() * sizeof(void*);
+		uint8_t forward[6] = { 0xFF, 0x25 };          // jmp    [fnHooked]
+		const int32_t forwardDisplacement = static_cast<int32_t>(offsetof(HookBase, fnHooked)) - static_cast<int32_t>(forwardOffset + sizeof(forward));
+		memcpy(forward + 2, &forwardDisplacement, sizeof(forwardDisplacement));
+
+		void* allocationBase = HookAllocator::allocate(forwardOffset + sizeof(forward));
+		if (!allocationBase) return nullptr;
+
+		HookBaseTemplate<Context>* stub = new(allocationBase) HookBaseTemplate<Context>{};
+		memcpy(reinterpret_cast<uint8_t*>(allocationBase) + sizeof(HookBase), code.data(), code.size());
+
+		void** functions = reinterpret_cast<void**>(reinterpret_cast<uint8_t*>(allocationBase) + tableOffset);
+		for (size_t i = 0; i < hooks.size(); ++i) functions[i] = hooks[i].hook->fnNew;
+		memcpy(reinterpret_cast<uint8_t*>(allocationBase) + forwardOffset, forward, sizeof(forward));
+		stub->extra = functions;
+		return reinterpret_cast<HookBase*>(stub);
+	}
+
+	template <typename Context> static void destroy(void* allocation)
+	{
+		reinterpret_cast<HookBaseTemplate<Context>*>(allocation)->~HookBaseTemplate<Context>();
+		HookAllocator::free(allocation);
+	}
+
+	template <typename Context> static bool isQuiescent(void* allocation)
+	{
+		return reinterpret_cast<HookBaseTemplate<Context>*>(allocation)->isPoolFull(sizeof(Context*));
+	}
+
+	// Destroys a stub which was never placed.
+	static void destroy(HookBase* stub, bool vector)
+	{
+		if (vector) HookChainCompiler::destroy<HookContext>(stub);
+		else HookChainCompiler::destroy<HookIntegerContext>(stub);
+	}
+
+	// Hands a stub replaced in its chain over to HookReclaimer.
+	static void retire(HookBase* stub, bool vector)
+	{
+		if (vector) HookReclaimer::retire(stub, &HookChainCompiler::destroy<HookContext>, &HookChainCompiler::isQuiescent<HookContext>);
+		else HookReclaimer::retire(stub, &HookChainCompiler::destroy<HookIntegerContext>, &HookChainCompiler::isQuiescent<HookIntegerContext>);
+	}
+
+	static inline std::mutex mutex{};
+	static inline std::unordered_map<HookBase*, bool> registered{}; // hooks which may be flattened, true for EntryHookV types
+	static inline std::unordered_map<void**, Compiled> entries{}; // the compiled virtual function table entries
+};
+
+/// <summary>
+/// Collects the call statistics of live instrumented hooks (VFTHookTemplate&lt;InstrumentedHook&lt;...&gt;&gt;).
+/// </summary>
+class HookProfiler {
+public:
+	struct HookProfile {
+		std::string name; // the demangled name of the hooked class, empty if its virtual function table has no scanned RTTI
+		unsigned int vftIndex;
+		uint64_t calls;
+		uint64_t totalCycles; // rdtsc ticks spent in the hook function over all calls
+		uint64_t maxCycles; // rdtsc ticks spent in the slowest call
+	};
+
+	/// <summary>
+	/// Static. Reads the stats of every live instrumented hook, summing up their per-thread stripes.
+	/// The stats are read while calls may be in progress, every field is exact on its own but they may be off by a call from each other.
+	/// </summary>
+	/// <returns>a vector of the stats of every hook, in the order the hooks were placed in</returns>
+	static std::vector<HookProfile> snapshot()
+	{
+		std::lock_guard<std::mutex> lock(HookProfiler::mutex);
+		HookProfiler::resolveNames();
+
+		std::vector<HookProfile> profiles;
+		profiles.reserve(HookProfiler::hooks.size());
+		for (const Registration& hook : HookProfiler::hooks) {
+			HookProfile profile{ hook.name, hook.vftIndex, 0, 0, 0 };
+			for (const HookStats::Stripe& stripe : hook.stats->stripes) {
+				profile.calls += stripe.calls.load(std::memory_order_relaxed);
+				profile.totalCycles += stripe.cycles.load(std::memory_order_relaxed);
+				profile.maxCycles = (std::max)(profile.maxCycles, stripe.maxCycles.load(std::memory_order_relaxed));
+			}
+			profiles.push_back(std::move(profile));
+		}
+		return profiles;
+	}
+
+	/// <summary>
+	/// Static. Clears the stats of every live instrumented hook, e.g. at the start of a frame.
+	/// </summary>
+	static void reset()
+	{
+		std::lock_guard<std::mutex> lock(HookProfiler::mutex);
+		for (const Registration& hook : HookProfiler::hooks) hook.stats->reset();
+	}
+
+	/// <summary>
+	/// Static. Adds a hook to the snapshots, called by VFTHookTemplate.
+	/// </summary>
+	/// <param name="stats">: the stats of the hook</param>
+	/// <param name="pVirtualFunctionTable">: pointer to the hooked virtual function table</param>
+	/// <param name="vftIndex">: index of the hooked virtual function</param>
+	static void add(HookStats* stats, void** pVirtualFunctionTable, unsigned int vftIndex)
+	{
+		std::lock_guard<std::mutex> lock(HookProfiler::mutex);
+		HookProfiler::hooks.push_back({ stats, pVirtualFunctionTable, vftIndex, {}, false });
+		HookProfiler::unresolved = true;
+	}
+
+	/// <summary>
+	/// Static. Removes a hook from the snapshots, called by VFTHookTemplate.
+	/// </summary>
+	/// <param name="stats">: the stats of the hook</param>
+	static void remove(HookStats* stats)
+	{
+		std::lock_guard<std::mutex> lock(HookProfiler::mutex);
+		for (auto iter = HookProfiler::hooks.begin(); iter != HookProfiler::hooks.end(); ++iter) {
+			if (iter->stats == stats) {
+				HookProfiler::hooks.erase(iter);
+				return;
+			}
+		}
+	}
+
+private:
+	struct Registration {
+		HookStats* stats;
+		void** pVirtualFunctionTable;
+		unsigned int vftIndex;
+		std::string name;
+		bool resolved;
+	};
+
+	// Looks up the class names of newly added hooks by their virtual function tables, once per hook.
+	// Must be called with mutex held.
+	static void resolveNames()
+	{
+		if (!HookProfiler::unresolved) return;
+		HookProfiler::unresolved = false;
+
+		for (Registration& hook : HookProfiler::hooks) {
+			if (hook.resolved) continue;
+
+			RTTIScanner::RTTI* pRTTI = RTTIScanner::getClassRTTIFromVFT(hook.pVirtualFunctionTable);
+			if (pRTTI) hook.name = pRTTI->getName();
+			hook.resolved = true;
+		}
+	}
+
+	static inline std::mutex mutex{};
+	static inline std::vector<Registration> hooks{};
+	static inline bool unresolved = false;
+};
+
+template <typename HookType> class VFTHookGroupTemplate;
 
 /// <summary>
 /// A managed hook template.
@@ -14,11 +1364,13 @@
 /// Without modification to the assembly, all function arguments passed to the original function
 /// will be preserved when calling the hook function, besides those directly passed on the stack.
 /// Calling delete on a hook instance automatically unhooks it.
+/// Indices past the end of a scanned virtual function table are rejected, the hook is not placed.
 /// </summary>
 template <typename HookType> class VFTHookTemplate {
 public:
 	/// <summary>
 	/// Places a hook function instead of a virtual function from a class found by name at a given index.
+	/// The class is looked up in the scanned executable first, then in the modules of RTTIRegistry.
 	/// </summary>
 	/// <param name="className">: full name of the class</param>
 	/// <param name="vftIndex">: index of the virtual function inside of the virtual function table</param>
@@ -26,6 +1378,7 @@ public:
 	template <typename F> VFTHookTemplate(const char* className, const unsigned int vftIndex, F* function)
 	{
 		RTTIScanner::RTTI* pClass = RTTIScanner::getClassRTTI(className);
+		if (!pClass) pClass = RTTIRegistry::getClassRTTI(className);
 		if (!pClass) return;
 
 		hook(pClass->pVirtualFunctionTable, vftIndex, function);
@@ -43,112 +1396,489 @@ public:
 	}
 
 	/// <summary>
-	/// Unhooks a virtual function, restoring the original function pointer while preserving the hook chain (if it exists)
+	/// Places a hook function instead of a virtual function from a class found by name at a given index.
+	/// For hook types with a trampoline (ThunkHook), which the hook function calls to reach the original function.
 	/// </summary>
-	virtual ~VFTHookTemplate()
+	/// <param name="className">: full name of the class</param>
+	/// <param name="vftIndex">: index of the virtual function inside of the virtual function table</param>
+	/// <param name="function">: function to call from the hook</param>
+	/// <param name="pOriginal">: receives the trampoline before the hook is placed, it stays valid for the lifetime of the hook</param>
+	template <typename F> VFTHookTemplate(const char* className, const unsigned int vftIndex, F* function, F** pOriginal)
 	{
-		HookType* hook = reinterpret_cast<HookType*>(allocationBase);
-		if (!hook) return;
+		RTTIScanner::RTTI* pClass = RTTIScanner::getClassRTTI(className);
+		if (!pClass) pClass = RTTIRegistry::getClassRTTI(className);
+		if (!pClass) return;
 
-		// find the topmost in the chain hook
-		HookType* topHook = hook;
-		while (reinterpret_cast<HookType*>(topHook->hookData.previous)->hookData.magic == hook->hookData.magic) {
-			topHook = reinterpret_cast<HookType*>(topHook->hookData.previous);
-		}
+		hook(pClass->pVirtualFunctionTable, vftIndex, function, pOriginal);
+	}
 
-		// lock top hook's mutex when hooking and unhooking
-		std::mutex& mutex = *topHook->hookData.mutex;
-		mutex.lock();
+	/// <summary>
+	/// Places a hook function instead of a virtual function in a virtual function table at a given index.
+	/// For hook types with a trampoline (ThunkHook), which the hook function calls to reach the original function.
+	/// </summary>
+	/// <param name="pVirtualFunctionTable">: pointer to the virtual function table</param>
+	/// <param name="vftIndex">: index of the virtual function inside of the virtual function table</param>
+	/// <param name="function">: function to call from the hook</param>
+	/// <param name="pOriginal">: receives the trampoline before the hook is placed, it stays valid for the lifetime of the hook</param>
+	template <typename Vft, typename F> VFTHookTemplate(Vft* pVirtualFunctionTable, const unsigned int vftIndex, F* function, F** pOriginal)
+	{
+		hook(pVirtualFunctionTable, vftIndex, function, pOriginal);
+	}
 
-		// the hook data is above the actual hook function pointed at
-		HookType* nextHook = reinterpret_cast<HookType*>(reinterpret_cast<uintptr_t>(hook->hookData.fnHooked) - sizeof(HookBase));
-		HookType* prevHook = reinterpret_cast<HookType*>(hook->hookData.previous);
+	/// <summary>
+	/// Static. Places a hook function instead of a virtual function from a class found by name, as soon as a module defining the class
+	/// is registered with RTTIRegistry (see RTTIRegistry::enableIncrementalScan), or right away if one already is.
+	/// </summary>
+	/// <param name="className">: full name of the class</param>
+	/// <param name="vftIndex">: index of the virtual function inside of the virtual function table</param>
+	/// <param name="function">: function to call from the hook</param>
+	/// <param name="pHook">: (optional) receives the hook once it is placed, otherwise the hook is never removed</param>
+	template <typename F> static void hookWhenLoaded(const char* className, const unsigned int vftIndex, F* function, std::atomic<VFTHookTemplate*>* pHook = nullptr)
+	{
+		RTTIRegistry::onClassLoaded(className, [vftIndex, function, pHook](RTTIScanner::RTTI& rtti) {
+			VFTHookTemplate* hook = new VFTHookTemplate(rtti.pVirtualFunctionTable, vftIndex, function);
+			if (pHook) pHook->store(hook);
+		});
+	}
 
-		// if the hook to be removed is in a chain, the reference to it is removed from the chain
-		if (hook->hookData.magic == nextHook->hookData.magic) {
-			VFTHookTemplate::rdataWrite(&nextHook->hookData.previous, prevHook);
-		}
+	/// <summary>
+	/// Unhooks a virtual function, restoring the original function pointer while preserving the hook chain (if it exists).
+	/// Returns immediately, the hook instance is destroyed by HookReclaimer once no thread can be using it.
+	/// A hook which could not be unlinked, e.g. because its entry could not be made writable, stays in place and is leaked.
+	/// </summary>
+	virtual ~VFTHookTemplate()
+	{
+		HookType* hook = reinterpret_cast<HookType*>(allocationBase);
+		if (!hook) return;
 
-		// if the previous function is a hook, replace the function it hooks (the current hook) 
-		// with the function the current hook hooked. If it's not a hook, unhook the virtual function table.
-		if (hook->hookData.magic == prevHook->hookData.magic) {
-			VFTHookTemplate::rdataWrite(&prevHook->hookData.fnHooked, hook->hookData.fnHooked);
-		}
+		bool removed = true;
+		if constexpr (isEntryHook<HookType>) removed = HookChainCompiler::remove(this->vftEntry, hook);
 		else {
-			VFTHookTemplate::rdataWrite(prevHook, hook->hookData.fnHooked);
+			HookReclaimer::Guard guard{};
+			removed = HookChain::remove(this->vftEntry, hook);
 		}
 
-		// the hook is freed, we can unlock
-		mutex.unlock();
+		// the entry or the hook above may still point into the instance, freeing it would leave them dangling
+		if (!removed) return;
 
-		// destroy the hook and free the memory.
-		hook->~HookType();
-		VirtualFree(this->allocationBase, NULL, MEM_RELEASE);
+		VFTHookTemplate::retire(hook);
 	}
 
 	/// <summary>
 	/// Write a pointer to potentially read-only memory, restoring the protection flags afterwards.
+	/// If a VFTHookBatch is active on the current thread, the write goes through it instead.
 	/// </summary>
 	/// <param name="pAddress">: a pointer to the address in memory to be written to</param>
 	/// <param name="pointer">: a pointer to write to memory</param>
 	/// <returns>true on a successful write, otherwise false</returns>
 	template <typename T1, typename T2> static bool rdataWrite(T1* pAddress, T2* pointer)
 	{
-		DWORD oldProtect;
-		if (!VirtualProtect(reinterpret_cast<void*>(pAddress), sizeof(uintptr_t), PAGE_EXECUTE_READWRITE, &oldProtect)) return false;
+		if (VFTHookBatch* batch = VFTHookBatch::getActive()) return batch->write(pAddress, pointer);
+
+		if (!PageProtection::open(pAddress)) return false;
 		_mm_mfence();
 		*reinterpret_cast<uintptr_t*>(pAddress) = reinterpret_cast<uintptr_t>(pointer);
-		return VirtualProtect(reinterpret_cast<void*>(pAddress), sizeof(uintptr_t), oldProtect, &oldProtect);
+		return PageProtection::close(pAddress);
 	}
 
 private:
-	template <typename Vft, typename F> void hook(Vft* pVirtualFunctionTable, const unsigned int vftIndex, F* function)
+	template <typename> friend class VFTHookGroupTemplate;
+
+	// Constructs a hook instance in allocated memory, set up to be inserted into a chain.
+	// The mutex is only kept for hooks placed with older versions.
+	static HookType* create(void* allocationBase, void* function, std::shared_ptr<std::mutex> mutex)
+	{
+		HookType* hook = new(allocationBase) HookType{};
+		hook->hookData.mutex = std::move(mutex);
+		if constexpr (isInstrumentedHook<HookType>) hook->setFunction(function);
+		else hook->hookData.fnNew = function;
+		return hook;
+	}
+
+	// Hands a hook removed from its chain over to HookReclaimer, which destroys it and returns the memory to the slab once it is safe.
+	static void retire(HookType* hook, bool reclaim = true)
+	{
+		if constexpr (isInstrumentedHook<HookType>) HookProfiler::remove(hook->stats.get());
+
+		HookReclaimer::retire(hook, [](void* allocation) {
+			reinterpret_cast<HookType*>(allocation)->~HookType();
+			HookAllocator::free(allocation);
+		}, [](void* allocation) {
+			const HookType& hook = *reinterpret_cast<HookType*>(allocation);
+			if constexpr (isInstrumentedHook<HookType>) {
+				if (!hook.isIdle()) return false;
+			}
+			return HookQuiescence<HookType>::isPoolFull(hook);
+		}, HookQuiescence<HookType>::usesThreadStacks, HookQuiescence<HookType>::needsRelease, reclaim);
+	}
+
+	// Checks an index against the function count of a scanned table, found in the executable's class map or in that of a registered module.
+	// Tables which were not scanned are not checked.
+	static bool isValidIndex(const void* pVirtualFunctionTable, const unsigned int vftIndex)
+	{
+		const RTTIScanner::ClassIndex* classes = RTTIScanner::getClassIndex();
+		unsigned int functionCount = classes ? classes->getFunctionCount(pVirtualFunctionTable) : 0;
+		if (!functionCount) {
+			RTTIRegistry::Module* module = RTTIRegistry::getModuleContaining(pVirtualFunctionTable);
+			if (module) functionCount = module->classes->getFunctionCount(pVirtualFunctionTable);
+		}
+
+		return !functionCount || vftIndex < functionCount;
+	}
+
+	template <typename Vft, typename F, typename Original = std::nullptr_t> void hook(Vft* pVirtualFunctionTable, const unsigned int vftIndex, F* function, Original pOriginal = nullptr)
 	{
+		// an index past the end of a scanned table would overwrite the next table's complete object locator or data
+		if (!VFTHookTemplate::isValidIndex(pVirtualFunctionTable, vftIndex)) return;
+
 		// allocate executable memory for the hook
-		void* allocationBase = VirtualAlloc(nullptr, sizeof(HookType), MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+		void* allocationBase = HookAllocator::allocate(sizeof(HookType));
 		if (!allocationBase) return;
 
 		this->allocationBase = allocationBase;
-		HookType* hook = new(allocationBase) HookType{};
+		HookType* hook = VFTHookTemplate::create(allocationBase, reinterpret_cast<void*>(function), std::make_shared<std::mutex>());
 
 		void** vftEntry = &reinterpret_cast<void**>(pVirtualFunctionTable)[vftIndex];
 
-		// set up new hook data
-		hook->hookData.mutex.reset(new std::mutex);
-		hook->hookData.fnHooked = *vftEntry;
-		hook->hookData.previous = reinterpret_cast<void*>(vftEntry);
-		hook->hookData.fnNew = reinterpret_cast<void*>(function);
+		// the trampoline must be known before the hook can be called
+		if constexpr (!std::is_null_pointer_v<Original>) {
+			if (pOriginal) *pOriginal = reinterpret_cast<F*>(hook->asmTrampoline);
+		}
+
+		HookReclaimer::Guard guard{};
+		if (!HookChain::insert(vftEntry, hook)) {
+			hook->~HookType();
+			HookAllocator::free(allocationBase);
+			this->allocationBase = nullptr;
+			return;
+		}
+
+		this->vftEntry = vftEntry;
+		if constexpr (isEntryHook<HookType>) HookChainCompiler::add(hook, isVectorEntryHook<HookType>);
+		if constexpr (isInstrumentedHook<HookType>) HookProfiler::add(hook->stats.get(), reinterpret_cast<void**>(pVirtualFunctionTable), vftIndex);
+	}
+
+	void* allocationBase = nullptr;
+	void** vftEntry = nullptr;
+};
+
+/// <summary>
+/// A group of managed hooks, placing hook functions instead of virtual functions of a root class and of every class derived from it
+/// which still inherits them. A virtual function table is hooked at an index if the function at the bottom of its chain
+/// is the same as the root class's, overriding classes are left alone. The derived classes' tables are found through the hierarchy
+/// and reverse virtual function table indices of RTTIScanner::ClassIndex, secondary tables of multiply inherited classes included.
+/// Entries which are not hooked yet all point at one shared hook instance per hooked function, so hooking an implementation
+/// inherited by hundreds of classes takes a single stub, context pool and mutex. Entries with a chain of their own get their own instance.
+/// The threads inside of a shared instance share its single pool, which grows with them (the fixed pools of the striped
+/// hook types hold UNIHOOK_THREAD_ACCESS_LIMIT entries for all of the group's entries at once).
+/// All hook instances are allocated at once and placed within a single VFTHookBatch, deleting the group unhooks all of them.
+/// Hook types with a trampoline (ThunkHook) are not supported, every hook of the group would need its own.
+/// </summary>
+template <typename HookType> class VFTHookGroupTemplate {
+	static_assert(!std::is_base_of_v<ThunkHook, HookType>, "hook types with a trampoline cannot be grouped");
+
+public:
+	/// <summary>
+	/// A virtual function to hook, by its index inside of the root class's virtual function table, and the function to call from its hooks.
+	/// </summary>
+	struct Slot {
+		template <typename F> Slot(const unsigned int vftIndex, F* function) : vftIndex(vftIndex), function(reinterpret_cast<void*>(function)) {}
+
+		unsigned int vftIndex;
+		void* function;
+	};
+
+	/// <summary>
+	/// Hooks virtual functions of a root class found by name and of the classes derived from it.
+	/// The class is looked up in the scanned executable first, then in the modules of RTTIRegistry.
+	/// </summary>
+	/// <param name="rootClassName">: full name of the root class</param>
+	/// <param name="slots">: the virtual functions to hook and the functions to call from the hooks</param>
+	VFTHookGroupTemplate(const char* rootClassName, const std::vector<Slot>& slots)
+	{
+		RTTIScanner::ClassIndex* classes = RTTIScanner::getClassIndex();
+		RTTIScanner::RTTI* pRoot = classes ? classes->find(rootClassName) : nullptr;
+		if (!pRoot) {
+			RTTIRegistry::forEachModule([&](RTTIRegistry::Module& module) {
+				if (pRoot) return;
+				pRoot = module.classes->find(rootClassName);
+				classes = module.classes.get();
+			});
+		}
+		if (!pRoot) return;
+
+		hook(*classes, *pRoot, slots);
+	}
+
+	/// <summary>
+	/// Hooks virtual functions of a root class and of the classes derived from it.
+	/// </summary>
+	/// <param name="classes">: the class map of the image defining the root class, e.g. RTTIScanner::getClassIndex()</param>
+	/// <param name="rootClass">: RTTI of the root class, from the same class map</param>
+	/// <param name="slots">: the virtual functions to hook and the functions to call from the hooks</param>
+	VFTHookGroupTemplate(const RTTIScanner::ClassIndex& classes, const RTTIScanner::RTTI& rootClass, const std::vector<Slot>& slots)
+	{
+		hook(classes, rootClass, slots);
+	}
+
+	/// <summary>
+	/// Hooks an implementation of a virtual function everywhere it is used at an index, in every virtual function table of an image.
+	/// </summary>
+	/// <param name="classes">: the class map of the image, e.g. RTTIScanner::getClassIndex()</param>
+	/// <param name="vftIndex">: index of the virtual function inside of the virtual function tables</param>
+	/// <param name="implementation">: the virtual function to hook, as found at the bottom of the chains of the entries</param>
+	/// <param name="function">: function to call from the hooks</param>
+	template <typename F> VFTHookGroupTemplate(const RTTIScanner::ClassIndex& classes, const unsigned int vftIndex, const void* implementation, F* function)
+	{
+		std::vector<Table> tables;
+		classes.forEachVirtualFunctionTable([&tables](void** pVirtualFunctionTable, RTTIScanner::RTTI&, unsigned int, unsigned int functionCount) {
+			tables.push_back({ pVirtualFunctionTable, functionCount });
+		});
+
+		hook(tables, { { vftIndex, function } }, { const_cast<void*>(implementation) });
+	}
+
+	VFTHookGroupTemplate(const VFTHookGroupTemplate&) = delete;
+	VFTHookGroupTemplate& operator=(const VFTHookGroupTemplate&) = delete;
 
-		// get and check for any previously placed hooks, which will need to be chained together
-		// the hook data is above the actual hook function pointed to
-		HookType* prevHook = reinterpret_cast<HookType*>(reinterpret_cast<uintptr_t>(hook->hookData.fnHooked) - sizeof(HookBase));
-		if (hook->hookData.magic == prevHook->hookData.magic) {
-			// lock top hook's mutex when hooking and unhooking
-			std::mutex& mutex = *prevHook->hookData.mutex;
-			mutex.lock();
+	/// <summary>
+	/// Unhooks every hook of the group, see VFTHookGroupTemplate::unhook.
+	/// Instances still referenced by an entry which could not be unlinked are leaked.
+	/// </summary>
+	virtual ~VFTHookGroupTemplate()
+	{
+		this->unhook();
+	}
+
+	/// <summary>
+	/// Unhooks every hook of the group within a single VFTHookBatch, restoring every entry while preserving the hook chains.
+	/// Returns immediately, the hook instances are destroyed by HookReclaimer once no thread can be using them.
+	/// Entries which could not be unlinked are kept along with their instances, unhook may be called again to retry them.
+	/// </summary>
+	/// <returns>true if every entry was unhooked, otherwise false</returns>
+	bool unhook()
+	{
+		if (this->entries.empty()) return true;
 
-			// update hook pointers
-			_mm_mfence();
-			if (hook->hookData.fnHooked != *vftEntry) {
-				hook->hookData.fnHooked = *vftEntry;
-				prevHook = reinterpret_cast<HookType*>(reinterpret_cast<uintptr_t>(hook->hookData.fnHooked) - sizeof(HookBase));
+		std::vector<Entry> failed;
+		{
+			VFTHookBatch batch{};
+			HookReclaimer::Guard guard{};
+			for (const Entry& entry : this->entries) {
+				if (!HookChain::remove(entry.vftEntry, entry.hook)) failed.push_back(entry);
 			}
-			VFTHookTemplate::rdataWrite(&prevHook->hookData.previous, hook);
-			VFTHookTemplate::rdataWrite(vftEntry, reinterpret_cast<uint8_t*>(hook) + sizeof(HookBase));
+		}
 
-			// unlock the mutex
-			mutex.unlock();
+		// a shared instance may only be retired once every entry referencing it has been unlinked
+		std::vector<HookType*> kept;
+		for (HookType* hook : this->instances) {
+			auto isReferenced = [hook](const Entry& entry) { return entry.hook == hook; };
+			if (std::any_of(failed.begin(), failed.end(), isReferenced)) kept.push_back(hook);
+			else VFTHookTemplate<HookType>::retire(hook, false);
 		}
-		else {
-			_mm_mfence();
-			if (hook->hookData.fnHooked != *vftEntry) hook->hookData.fnHooked = *vftEntry;
+		// one pass over the threads for all of them
+		HookReclaimer::reclaim();
+
+		this->entries = std::move(failed);
+		this->instances = std::move(kept);
+		return this->entries.empty();
+	}
+
+	/// <summary>
+	/// Retrieves the amount of virtual function table entries hooked by the group.
+	/// </summary>
+	size_t size() const noexcept { return this->entries.size(); }
+
+	/// <summary>
+	/// Retrieves the amount of hook instances used by the group, one per hooked function plus one per entry which was already hooked.
+	/// After VFTHookGroupTemplate::unhook, only the instances shared by entries which could not be unlinked are left.
+	/// </summary>
+	size_t getInstanceCount() const noexcept { return this->instances.size(); }
+
+	/// <summary>
+	/// Calls a function for every virtual function table entry hooked by the group, in the order they were hooked in.
+	/// </summary>
+	/// <param name="function">: a function taking (void** vftEntry, unsigned int vftIndex)</param>
+	template <typename F> void forEachEntry(F&& function) const
+	{
+		for (const Entry& entry : this->entries) function(entry.vftEntry, entry.vftIndex);
+	}
+
+private:
+	// Counts the leading entries of a virtual function table which point into executable memory, reading at most limit entries.
+	// Used for tables the class map has no function count for, the gap up to the next table may hold other read-only data.
+	static size_t countFunctions(void** pVirtualFunctionTable, size_t limit)
+	{
+		MEMORY_BASIC_INFORMATION region{};
+		for (size_t i = 0; i < limit; ++i) {
+			if (!VFTHookGroupTemplate::isExecutable(pVirtualFunctionTable[i], region)) return i;
+		}
+		return limit;
+	}
 
-			// write a pointer to the hook to the virtual function table
-			VFTHookTemplate::rdataWrite(vftEntry, reinterpret_cast<uint8_t*>(hook) + sizeof(HookBase));
+	// Tells whether an address is in committed executable memory, region caches the last region queried.
+	static bool isExecutable(const void* address, MEMORY_BASIC_INFORMATION& region)
+	{
+		const uintptr_t value = reinterpret_cast<uintptr_t>(address);
+		const uintptr_t base = reinterpret_cast<uintptr_t>(region.BaseAddress);
+		if (!region.RegionSize || value < base || value - base >= region.RegionSize) {
+			if (!VirtualQuery(address, &region, sizeof(region))) {
+				region.RegionSize = 0;
+				return false;
+			}
 		}
+
+		constexpr DWORD executable = PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+		return region.State == MEM_COMMIT && (region.Protect & executable);
 	}
 
-	void* allocationBase = nullptr;
+	// A virtual function table and the amount of functions in it.
+	struct Table {
+		void** pVirtualFunctionTable;
+		size_t functionCount;
+	};
+
+	// A hooked entry. The referencing entries of a shared instance are kept here rather than in HookBase::previous:
+	// chain operations do not rely on previous pointers, which are overwritten by any hook placed on top.
+	struct Entry {
+		void** vftEntry;
+		HookType* hook;
+		unsigned int vftIndex;
+	};
+
+	void hook(const RTTIScanner::ClassIndex& classes, const RTTIScanner::RTTI& rootClass, const std::vector<Slot>& slots)
+	{
+		// the tables of the root class and the classes derived from it, with their function counts from the scan
+		std::vector<Table> tables;
+		classes.forEachVirtualFunctionTable([&](void** pVirtualFunctionTable, RTTIScanner::RTTI& rtti, unsigned int, unsigned int functionCount) {
+			if (&rtti == &rootClass || classes.isDerivedFrom(rtti, rootClass)) tables.push_back({ pVirtualFunctionTable, functionCount });
+		});
+		// the reverse index is empty for class maps without one, the root's primary table is hooked regardless and counted here
+		size_t limit = 0;
+		for (const Slot& slot : slots) limit = (std::max)(limit, static_cast<size_t>(slot.vftIndex) + 1);
+		auto root = std::find_if(tables.begin(), tables.end(), [&](const Table& table) { return table.pVirtualFunctionTable == rootClass.pVirtualFunctionTable; });
+		if (root == tables.end()) {
+			tables.push_back({ rootClass.pVirtualFunctionTable, VFTHookGroupTemplate::countFunctions(rootClass.pVirtualFunctionTable, limit) });
+			root = tables.end() - 1;
+		}
+		const size_t rootFunctionCount = root->functionCount;
+
+		std::vector<void*> originals;
+		{
+			HookReclaimer::Guard guard{};
+			// slots past the end of the root's table have no original and are left unhooked
+			for (const Slot& slot : slots) {
+				originals.push_back(slot.vftIndex < rootFunctionCount ? HookChain::getOriginal(rootClass.pVirtualFunctionTable[slot.vftIndex]) : nullptr);
+			}
+		}
+
+		hook(tables, slots, originals);
+	}
+
+	// Hooks the entries of every slot whose chain ends in the slot's original function.
+	void hook(const std::vector<Table>& tables, const std::vector<Slot>& slots, const std::vector<void*>& originals)
+	{
+		HookReclaimer::Guard guard{};
+
+		struct Target {
+			void** vftEntry;
+			size_t slotIndex;
+			bool shared; // not hooked yet, the entry can point at the shared instance
+		};
+		std::vector<Target> targets;
+		size_t instanceCount = 0;
+		for (size_t i = 0; i < slots.size(); ++i) {
+			if (!originals[i]) continue;
+
+			bool sharing = false;
+			for (const Table& table : tables) {
+				if (slots[i].vftIndex >= table.functionCount) continue;
+
+				void** vftEntry = &table.pVirtualFunctionTable[slots[i].vftIndex];
+				void* top = *vftEntry;
+				if (HookChain::getOriginal(top) != originals[i]) continue;
+
+				const bool shared = top == originals[i];
+				instanceCount += !shared || !sharing;
+				sharing |= shared;
+				targets.push_back({ vftEntry, i, shared });
+			}
+		}
+		if (targets.empty()) return;
+
+		std::vector<void*> allocations(instanceCount);
+		allocations.resize(HookAllocator::allocate(sizeof(HookType), instanceCount, allocations.data()));
+
+		// the mutex is only kept for hooks placed with older versions, the whole group shares one
+		std::shared_ptr<std::mutex> mutex = std::make_shared<std::mutex>();
+		auto createInstance = [&](const Target& target) -> HookType* {
+			void* allocationBase = nullptr;
+			if (!allocations.empty()) {
+				allocationBase = allocations.back();
+				allocations.pop_back();
+			}
+			else {
+				// an entry was hooked between counting and placing, it needs an instance of its own
+				allocationBase = HookAllocator::allocate(sizeof(HookType));
+				if (!allocationBase) return nullptr;
+			}
+			return VFTHookTemplate<HookType>::create(allocationBase, slots[target.slotIndex].function, mutex);
+		};
+		auto destroyInstance = [](HookType* hook) {
+			hook->~HookType();
+			HookAllocator::free(hook);
+		};
+		auto addInstance = [this](HookType* hook, const Target& target, unsigned int vftIndex) {
+			this->instances.push_back(hook);
+			if constexpr (isInstrumentedHook<HookType>) HookProfiler::add(hook->stats.get(), target.vftEntry - vftIndex, vftIndex);
+		};
+
+		VFTHookBatch batch{};
+		this->entries.reserve(this->entries.size() + targets.size());
+		HookType* sharedHook = nullptr;
+		bool sharedPlaced = false;
+		for (size_t i = 0; i < targets.size(); ++i) {
+			const Target& target = targets[i];
+			const unsigned int vftIndex = slots[target.slotIndex].vftIndex;
+
+			bool placed = false;
+			if (target.shared) {
+				if (!sharedHook) {
+					sharedHook = createInstance(target);
+					if (sharedHook) sharedHook->hookData.fnHooked = originals[target.slotIndex];
+				}
+				if (sharedHook && HookChain::insertShared(target.vftEntry, sharedHook)) {
+					if (!sharedPlaced) addInstance(sharedHook, target, vftIndex);
+					sharedPlaced = placed = true;
+					this->entries.push_back({ target.vftEntry, sharedHook, vftIndex });
+				}
+			}
+
+			if (HookType* hook = placed ? nullptr : createInstance(target)) {
+				if (HookChain::insert(target.vftEntry, hook)) {
+					addInstance(hook, target, vftIndex);
+					this->entries.push_back({ target.vftEntry, hook, vftIndex });
+				}
+				else {
+					destroyInstance(hook);
+				}
+			}
+
+			// the targets are ordered by slot, the shared instance of a slot is done with at its last target
+			if (i + 1 == targets.size() || targets[i + 1].slotIndex != target.slotIndex) {
+				if (sharedHook && !sharedPlaced) destroyInstance(sharedHook);
+				sharedHook = nullptr;
+				sharedPlaced = false;
+			}
+		}
+
+		for (void* allocationBase : allocations) HookAllocator::free(allocationBase);
+	}
+
+	std::vector<Entry> entries;
+	std::vector<HookType*> instances; // every instance once, shared or not
 };
 
 using VFTHook = VFTHookTemplate<EntryHook>;
+using VFTThunkHook = VFTHookTemplate<ThunkHook>;
+using VFTHookGroup = VFTHookGroupTemplate<EntryHook>;